@@ -1,8 +1,16 @@
+# usage: ./build.sh [Debug|Release|RelWithDebInfo|pgo] [cmake options...]
+BUILD_TYPE=${1:-Release}
+[ $# -gt 0 ] && shift
+
 mkdir -p build
 mkdir -p bin
 
 cd build
 
-cmake -D CMAKE_BUILD_TYPE=Debug CMAKE_INSTALL_PREFIX=. ..
-
-make
\ No newline at end of file
+if [ "$BUILD_TYPE" = "pgo" ]; then
+    rm -rf pgo
+    cmake -D CMAKE_BUILD_TYPE=Release -D PGO=GENERATE -D CMAKE_INSTALL_PREFIX=. "$@" .. && make && make bench || exit 1
+    cmake -D PGO=USE .. && make clean && make
+else
+    cmake -D CMAKE_BUILD_TYPE=$BUILD_TYPE -D CMAKE_INSTALL_PREFIX=. "$@" .. && make
+fi
@@ -0,0 +1,270 @@
+/*
+ * Ports the chapter07 primitives and their pthread counterparts to the
+ * bench harness, so a change to any of them shows up as a number.
+ *
+ *   primitives_bench --threads 1-8 --save base.csv
+ *   primitives_bench --threads 1-8 --baseline base.csv --tolerance 10
+ */
+#include <pthread.h>
+#include <semaphore.h>
+#include "errors.h"
+#include "bench.h"
+#include "barrier.h"
+#include "rwlock.h"
+#include "spinlock.h"
+#include "workq.h"
+
+typedef struct primitives_tag {
+    pthread_mutex_t     mutex;
+    pthread_spinlock_t  pspin;
+    pthread_rwlock_t    prwlock;
+    pthread_barrier_t   pbarrier;
+    spinlock_t          spin;
+    rwlock_t            rwlock;
+    barrier_t           barrier;
+    sem_t               sem;
+    workq_t             wq;
+    long                submitted;
+    long                completed;
+    long                counter;
+} primitives_t;
+
+static primitives_t shared;
+
+static int mutex_setup(void *arg, int threads)
+{
+    return pthread_mutex_init(&shared.mutex, NULL);
+}
+
+static void mutex_run(void *arg, int thread, long ops)
+{
+    long count;
+
+    for (count = 0; count < ops; count++) {
+        pthread_mutex_lock(&shared.mutex);
+        shared.counter++;
+        pthread_mutex_unlock(&shared.mutex);
+    }
+}
+
+static int mutex_teardown(void *arg)
+{
+    return pthread_mutex_destroy(&shared.mutex);
+}
+
+static int spinlock_setup(void *arg, int threads)
+{
+    spinlock_init(&shared.spin);
+    return 0;
+}
+
+static void spinlock_run(void *arg, int thread, long ops)
+{
+    long count;
+
+    for (count = 0; count < ops; count++) {
+        spinlock_lock(&shared.spin);
+        shared.counter++;
+        spinlock_unlock(&shared.spin);
+    }
+}
+
+static int spinlock_teardown(void *arg)
+{
+    spinlock_destroy(&shared.spin);
+    return 0;
+}
+
+static int pspin_setup(void *arg, int threads)
+{
+    return pthread_spin_init(&shared.pspin, PTHREAD_PROCESS_PRIVATE);
+}
+
+static void pspin_run(void *arg, int thread, long ops)
+{
+    long count;
+
+    for (count = 0; count < ops; count++) {
+        pthread_spin_lock(&shared.pspin);
+        shared.counter++;
+        pthread_spin_unlock(&shared.pspin);
+    }
+}
+
+static int pspin_teardown(void *arg)
+{
+    return pthread_spin_destroy(&shared.pspin);
+}
+
+static int rwlock_setup(void *arg, int threads)
+{
+    return rwl_init(&shared.rwlock);
+}
+
+/*
+ * arg is the write percentage.
+ */
+static void rwlock_run(void *arg, int thread, long ops)
+{
+    long count, writes = (long)arg;
+
+    for (count = 0; count < ops; count++) {
+        if (count % 100 < writes) {
+            rwl_writelock(&shared.rwlock);
+            shared.counter++;
+            rwl_writeunlock(&shared.rwlock);
+        } else {
+            rwl_readlock(&shared.rwlock);
+            rwl_readunlock(&shared.rwlock);
+        }
+    }
+}
+
+static int rwlock_teardown(void *arg)
+{
+    return rwl_destroy(&shared.rwlock);
+}
+
+static int prwlock_setup(void *arg, int threads)
+{
+    return pthread_rwlock_init(&shared.prwlock, NULL);
+}
+
+static void prwlock_run(void *arg, int thread, long ops)
+{
+    long count, writes = (long)arg;
+
+    for (count = 0; count < ops; count++) {
+        if (count % 100 < writes) {
+            pthread_rwlock_wrlock(&shared.prwlock);
+            shared.counter++;
+            pthread_rwlock_unlock(&shared.prwlock);
+        } else {
+            pthread_rwlock_rdlock(&shared.prwlock);
+            pthread_rwlock_unlock(&shared.prwlock);
+        }
+    }
+}
+
+static int prwlock_teardown(void *arg)
+{
+    return pthread_rwlock_destroy(&shared.prwlock);
+}
+
+static int barrier_setup(void *arg, int threads)
+{
+    return barrier_init(&shared.barrier, threads);
+}
+
+static void barrier_run(void *arg, int thread, long ops)
+{
+    long count;
+
+    for (count = 0; count < ops; count++)
+        barrier_wait(&shared.barrier);
+}
+
+static int barrier_teardown(void *arg)
+{
+    return barrier_destroy(&shared.barrier);
+}
+
+static int pbarrier_setup(void *arg, int threads)
+{
+    return pthread_barrier_init(&shared.pbarrier, NULL, threads);
+}
+
+static void pbarrier_run(void *arg, int thread, long ops)
+{
+    long count;
+
+    for (count = 0; count < ops; count++)
+        pthread_barrier_wait(&shared.pbarrier);
+}
+
+static int pbarrier_teardown(void *arg)
+{
+    return pthread_barrier_destroy(&shared.pbarrier);
+}
+
+static int semaphore_setup(void *arg, int threads)
+{
+    return sem_init(&shared.sem, 0, 1) == 0 ? 0 : errno;
+}
+
+static void semaphore_run(void *arg, int thread, long ops)
+{
+    long count;
+
+    for (count = 0; count < ops; count++) {
+        while (sem_wait(&shared.sem) != 0 && errno == EINTR)
+            ;
+        shared.counter++;
+        sem_post(&shared.sem);
+    }
+}
+
+static int semaphore_teardown(void *arg)
+{
+    return sem_destroy(&shared.sem) == 0 ? 0 : errno;
+}
+
+static void workq_engine(void *arg)
+{
+    __atomic_add_fetch(&shared.completed, 1, __ATOMIC_RELEASE);
+}
+
+static int workq_setup(void *arg, int threads)
+{
+    shared.submitted = shared.completed = 0;
+    return workq_init(&shared.wq, threads, workq_engine);
+}
+
+static void workq_run(void *arg, int thread, long ops)
+{
+    long count;
+    int status;
+
+    for (count = 0; count < ops; count++) {
+        status = workq_add(&shared.wq, NULL);
+        if (status != 0)
+            err_abort(status, "Add work");
+    }
+    __atomic_add_fetch(&shared.submitted, ops, __ATOMIC_RELAXED);
+}
+
+static void workq_finish(void *arg)
+{
+    while (__atomic_load_n(&shared.completed, __ATOMIC_ACQUIRE) < shared.submitted)
+        sched_yield();
+}
+
+static int workq_teardown(void *arg)
+{
+    return workq_destroy(&shared.wq);
+}
+
+static bench_case_t cases[] = {
+    {"mutex", mutex_setup, mutex_run, NULL, mutex_teardown, NULL},
+    {"spinlock", spinlock_setup, spinlock_run, NULL, spinlock_teardown, NULL},
+    {"pthread_spinlock", pspin_setup, pspin_run, NULL, pspin_teardown, NULL},
+    {"rwlock_read", rwlock_setup, rwlock_run, NULL, rwlock_teardown, (void*)0},
+    {"rwlock_write10", rwlock_setup, rwlock_run, NULL, rwlock_teardown, (void*)10},
+    {"pthread_rwlock_read", prwlock_setup, prwlock_run, NULL, prwlock_teardown, (void*)0},
+    {"pthread_rwlock_write10", prwlock_setup, prwlock_run, NULL, prwlock_teardown, (void*)10},
+    {"barrier", barrier_setup, barrier_run, NULL, barrier_teardown, NULL},
+    {"pthread_barrier", pbarrier_setup, pbarrier_run, NULL, pbarrier_teardown, NULL},
+    {"semaphore", semaphore_setup, semaphore_run, NULL, semaphore_teardown, NULL},
+    {"workq", workq_setup, workq_run, workq_finish, workq_teardown, NULL},
+};
+
+int main(int argc, char *argv[])
+{
+    bench_config_t config;
+
+    bench_config_init(&config);
+    if (bench_parse_args(&config, argc, argv) != 0)
+        return 2;
+
+    return bench_run(&config, cases, sizeof(cases) / sizeof(cases[0])) == 0 ? 0 : 1;
+}
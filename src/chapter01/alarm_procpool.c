@@ -0,0 +1,90 @@
+#include <sys/types.h>
+#include <wait.h>
+#include "procpool.h"
+#include "errors.h"
+
+#define WORKERS 4
+
+typedef struct alarm_tag {
+	int  seconds;
+	char message[64];
+} alarm_t;
+
+void alarm_handler(void *arg) {
+	alarm_t *alarm = (alarm_t*)arg;
+
+	sleep(alarm->seconds);
+	printf("(%d) %s\n", alarm->seconds, alarm->message);
+}
+
+/*
+ * alarm_fork.c with a pre-forked pool in place of a fork per alarm.
+ * When every worker is busy the alarm is run by spawning this program
+ * again with --alarm.
+ */
+int main(int argc, char *argv[]) {
+	procpool_t pool;
+	pid_t pid;
+	alarm_t alarm;
+	int status;
+	char line[128];
+	char seconds[16];
+	char *spawn_argv[5];
+
+	if (argc > 3 && strcmp(argv[1], "--alarm") == 0) {
+		alarm.seconds = atoi(argv[2]);
+		snprintf(alarm.message, sizeof(alarm.message), "%s", argv[3]);
+		alarm_handler(&alarm);
+		exit(0);
+	}
+
+	status = procpool_init(&pool, argc > 1 ? atoi(argv[1]) : WORKERS, alarm_handler);
+	if (status != 0)
+		err_abort(status, "Init process pool");
+
+	while(1) {
+		printf("Alarm> ");
+		if (fgets(line, sizeof(line), stdin) == NULL)
+			break;
+
+		if (strlen(line) <= 1)
+			continue;
+
+		memset(&alarm, 0, sizeof(alarm));
+		if (sscanf(line, "%d %63[^\n]", &alarm.seconds, alarm.message) < 2) {
+			fprintf(stderr, "Bad command\n");
+			continue;
+		}
+
+		status = procpool_reap(&pool, 0, NULL);
+		if (status != 0)
+			err_abort(status, "Reap process pool");
+
+		if (pool.pending < pool.parallelism) {
+			status = procpool_submit(&pool, &alarm, sizeof(alarm));
+			if (status != 0)
+				err_abort(status, "Submit alarm");
+		} else {
+			snprintf(seconds, sizeof(seconds), "%d", alarm.seconds);
+			spawn_argv[0] = "/proc/self/exe";
+			spawn_argv[1] = "--alarm";
+			spawn_argv[2] = seconds;
+			spawn_argv[3] = alarm.message;
+			spawn_argv[4] = NULL;
+			status = procpool_spawn(&pid, spawn_argv);
+			if (status != 0)
+				err_abort(status, "Spawn alarm");
+		}
+
+		do {
+			pid = waitpid((pid_t)-1, NULL, WNOHANG);
+			if (pid == (pid_t) -1 && errno != ECHILD)
+				errno_abort("Wait for child");
+		} while(pid > (pid_t)0);
+	}
+
+	status = procpool_destroy(&pool);
+	if (status != 0)
+		err_abort(status, "Destroy process pool");
+	exit(0);
+}
@@ -0,0 +1,147 @@
+#include <sys/types.h>
+#include <wait.h>
+#include <time.h>
+#include "procpool.h"
+#include "errors.h"
+
+#define JOBS    2000
+#define WORKERS 4
+
+int ack_fd[2];
+
+unsigned long long now_nsec(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+int compare_latency(const void *a, const void *b) {
+	unsigned long long x = *(const unsigned long long*)a;
+	unsigned long long y = *(const unsigned long long*)b;
+
+	return x < y ? -1 : (x > y);
+}
+
+void null_handler(void *arg) {
+	(void) arg;
+}
+
+void wait_ack(int fd) {
+	char ack;
+
+	while (read(fd, &ack, 1) != 1)
+		if (errno != EINTR)
+			errno_abort("Read ack");
+}
+
+void run_job(const char *mode, procpool_t *pool) {
+	char *spawn_argv[4];
+	char fd_name[16];
+	pid_t pid;
+	int status;
+
+	if (strcmp(mode, "fork") == 0) {
+		pid = fork();
+		if (pid == (pid_t)-1)
+			errno_abort("Fork");
+		if (pid == (pid_t)0) {
+			if (write(ack_fd[1], "", 1) != 1)
+				_exit(1);
+			_exit(0);
+		}
+		wait_ack(ack_fd[0]);
+		if (waitpid(pid, NULL, 0) == (pid_t)-1)
+			errno_abort("Wait for child");
+	} else if (strcmp(mode, "spawn") == 0) {
+		snprintf(fd_name, sizeof(fd_name), "%d", ack_fd[1]);
+		spawn_argv[0] = "/proc/self/exe";
+		spawn_argv[1] = "--ack";
+		spawn_argv[2] = fd_name;
+		spawn_argv[3] = NULL;
+		status = procpool_spawn(&pid, spawn_argv);
+		if (status != 0)
+			err_abort(status, "Spawn");
+		wait_ack(ack_fd[0]);
+		if (waitpid(pid, NULL, 0) == (pid_t)-1)
+			errno_abort("Wait for child");
+	} else {
+		status = procpool_submit(pool, "", 1);
+		if (status != 0)
+			err_abort(status, "Submit job");
+		status = procpool_reap(pool, 1, NULL);
+		if (status != 0)
+			err_abort(status, "Reap job");
+	}
+}
+
+int main(int argc, char *argv[]) {
+	procpool_t pool;
+	unsigned long long *latency, start, total;
+	const char *mode = "pool";
+	size_t heap_mb = 0;
+	char *heap = NULL;
+	int jobs = JOBS, count, status;
+
+	if (argc > 2 && strcmp(argv[1], "--ack") == 0) {
+		if (write(atoi(argv[2]), "", 1) != 1)
+			return 1;
+		return 0;
+	}
+
+	if (argc > 1)
+		mode = argv[1];
+	if (argc > 2)
+		heap_mb = strtoul(argv[2], NULL, 0);
+	if (argc > 3)
+		jobs = atoi(argv[3]);
+
+	if (strcmp(mode, "fork") != 0 && strcmp(mode, "spawn") != 0
+		&& strcmp(mode, "pool") != 0) {
+		fprintf(stderr, "usage: %s [fork|spawn|pool [heap_mb [jobs]]]\n", argv[0]);
+		return 1;
+	}
+
+	if (heap_mb > 0) {
+		heap = (char*)malloc(heap_mb << 20);
+		if (heap == NULL)
+			errno_abort("Allocate heap");
+		memset(heap, 1, heap_mb << 20);
+	}
+
+	if (pipe(ack_fd) == -1)
+		errno_abort("Create ack pipe");
+
+	if (strcmp(mode, "pool") == 0) {
+		status = procpool_init(&pool, WORKERS, null_handler);
+		if (status != 0)
+			err_abort(status, "Init process pool");
+	}
+
+	latency = (unsigned long long*)malloc(jobs * sizeof(unsigned long long));
+	if (latency == NULL)
+		errno_abort("Allocate latency");
+
+	total = now_nsec();
+	for (count = 0; count < jobs; count++) {
+		start = now_nsec();
+		run_job(mode, &pool);
+		latency[count] = now_nsec() - start;
+	}
+	total = now_nsec() - total;
+
+	qsort(latency, jobs, sizeof(unsigned long long), compare_latency);
+	printf("%s, heap %zu MB: %.0f jobs/sec, p50 %llu us, p99 %llu us\n",
+		mode, heap_mb, jobs / (total / 1e9),
+		latency[jobs / 2] / 1000, latency[jobs * 99 / 100] / 1000);
+
+	if (strcmp(mode, "pool") == 0) {
+		status = procpool_destroy(&pool);
+		if (status != 0)
+			err_abort(status, "Destroy process pool");
+	}
+
+	free(latency);
+	free(heap);
+	return 0;
+}
@@ -0,0 +1,165 @@
+#include <pthread.h>
+#include <time.h>
+#include "mpsc.h"
+#include "errors.h"
+
+typedef struct alarm_tag
+{
+    struct alarm_tag    *link;
+    int                 seconds;
+    time_t              time;
+    char                message[64];
+} alarm_t;
+
+pthread_mutex_t alarm_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t alarm_cond = PTHREAD_COND_INITIALIZER;
+mpsc_t alarm_inbox = MPSC_INITIALIZER(alarm_t, link);
+alarm_t *alarm_list = NULL;
+
+void alarm_insert(alarm_t *alarm)
+{
+    alarm_t **last, *next;
+
+    last = &alarm_list;
+    next = *last;
+    while (next != NULL)
+    {
+        if (next->time >= alarm->time)
+        {
+            alarm->link = next;
+            *last = alarm;
+            break;
+        }
+        last = &next->link;
+        next = next->link;
+    }
+
+    if (next == NULL)
+    {
+        *last = alarm;
+        alarm->link = NULL;
+    }
+
+#ifdef DEBUG
+    printf("[list: ");
+    for (next = alarm_list; next != NULL; next = next->link)
+        printf("%d(%d)[\"%s\"]", next->time, next->time - time(NULL), next->message);
+    printf("]\n");
+#endif
+}
+
+void alarm_drain(void)
+{
+    alarm_t *alarm, *next;
+
+    for (alarm = mpsc_drain(&alarm_inbox); alarm != NULL; alarm = next) {
+        next = alarm->link;
+        alarm_insert(alarm);
+    }
+}
+
+void *alarm_thread(void *arg)
+{
+    alarm_t *alarm;
+    struct timespec cond_time;
+    time_t now;
+    int status;
+
+    status = pthread_mutex_lock(&alarm_mutex);
+    if (status != 0)
+        err_abort(status, "Lock mutex");
+
+    while(1) {
+        alarm_drain();
+
+        if (alarm_list == NULL) {
+            if (mpsc_empty(&alarm_inbox)) {
+                status = pthread_cond_wait(&alarm_cond, &alarm_mutex);
+                if (status != 0)
+                    err_abort(status, "Wait on cond");
+            }
+            continue;
+        }
+
+        alarm = alarm_list;
+        now = time(NULL);
+
+        if(alarm->time > now) {
+#ifdef DEBUG
+            printf("[waiting: %d(%ld)\"%s\"]\n", alarm->time, alarm->time - now, alarm->message);
+#endif
+            if (mpsc_empty(&alarm_inbox)) {
+                cond_time.tv_sec = alarm->time;
+                cond_time.tv_nsec = 0;
+                status = pthread_cond_timedwait(&alarm_cond, &alarm_mutex, &cond_time);
+                if (status != 0 && status != ETIMEDOUT)
+                    err_abort(status, "Cond timedwait");
+            }
+            continue;
+        }
+
+        alarm_list = alarm->link;
+
+        status = pthread_mutex_unlock(&alarm_mutex);
+        if (status != 0)
+            err_abort(status, "Unlock mutex");
+
+        printf("(%d) %s\n", alarm->seconds, alarm->message);
+        free(alarm);
+
+        status = pthread_mutex_lock(&alarm_mutex);
+        if (status != 0)
+            err_abort(status, "Lock mutex");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int status;
+    char line[128];
+    alarm_t *alarm;
+    pthread_t thread;
+
+    status = pthread_create(&thread, NULL, alarm_thread, NULL);
+    if (status != 0)
+        err_abort(status, "Create alarm thread");
+
+    while (1)
+    {
+        printf("Alarm> ");
+
+        if (fgets(line, sizeof(line), stdin) == NULL)
+            exit(0);
+
+        if (strlen(line) <= 1)
+            continue;
+
+        alarm = (alarm_t *)malloc(sizeof(alarm_t));
+        if (alarm == NULL)
+            errno_abort("Allocate alarm");
+
+        if (sscanf(line, "%d %63[^\n]", &alarm->seconds, alarm->message) < 2)
+        {
+            fprintf(stderr, "Bad command\n");
+            free(alarm);
+        }
+        else
+        {
+            alarm->time = time(NULL) + alarm->seconds;
+
+            if (mpsc_push(&alarm_inbox, alarm)) {
+                status = pthread_mutex_lock(&alarm_mutex);
+                if (status != 0)
+                    err_abort(status, "Lock mutex");
+
+                status = pthread_cond_signal(&alarm_cond);
+                if (status != 0)
+                    err_abort(status, "Signal cond");
+
+                status = pthread_mutex_unlock(&alarm_mutex);
+                if (status != 0)
+                    err_abort(status, "Unlock mutex");
+            }
+        }
+    }
+}
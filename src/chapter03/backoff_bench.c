@@ -0,0 +1,101 @@
+#include <pthread.h>
+#include <time.h>
+#include "lockset.h"
+#include "errors.h"
+
+#define ITERATIONS  20000
+#define MAX_THREADS 16
+
+pthread_mutex_t mutex[3] = {
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER};
+
+int policy = LOCK_ORDERED;
+int iterations = ITERATIONS;
+
+typedef struct thread_tag {
+    pthread_t       thread_id;
+    int             backward;
+    unsigned long   backoffs;
+} thread_t;
+
+void *lock_routine(void *arg)
+{
+    thread_t *self = (thread_t*)arg;
+    pthread_mutex_t *set[3];
+    int iterate, status;
+
+    if (self->backward) {
+        set[0] = &mutex[2];
+        set[1] = &mutex[1];
+        set[2] = &mutex[0];
+    } else {
+        set[0] = &mutex[0];
+        set[1] = &mutex[1];
+        set[2] = &mutex[2];
+    }
+
+    for (iterate = 0; iterate < iterations; iterate++) {
+        status = lock_many(set, 3, policy, &self->backoffs);
+        if (status != 0)
+            err_abort(status, "Lock many");
+
+        status = unlock_many(set, 3);
+        if (status != 0)
+            err_abort(status, "Unlock many");
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    thread_t threads[MAX_THREADS];
+    struct timespec start, end;
+    unsigned long backoffs;
+    double seconds;
+    int max_threads = 8, nthreads, count, status;
+
+    if (argc > 1)
+        policy = atoi(argv[1]);
+    if (argc > 2)
+        max_threads = atoi(argv[2]);
+    if (argc > 3)
+        iterations = atoi(argv[3]);
+
+    if (max_threads > MAX_THREADS)
+        max_threads = MAX_THREADS;
+
+    printf("policy %s\n", policy == LOCK_ORDERED ? "ordered" : "backoff");
+
+    for (nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (count = 0; count < nthreads; count++) {
+            threads[count].backward = count & 1;
+            threads[count].backoffs = 0;
+            status = pthread_create(&threads[count].thread_id, NULL,
+                lock_routine, (void*)&threads[count]);
+            if (status != 0)
+                err_abort(status, "Create thread");
+        }
+
+        backoffs = 0;
+        for (count = 0; count < nthreads; count++) {
+            status = pthread_join(threads[count].thread_id, NULL);
+            if (status != 0)
+                err_abort(status, "Join thread");
+            backoffs += threads[count].backoffs;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+        printf("%2d threads: %.0f acquisitions/sec, %.4f backoffs/acquisition\n",
+            nthreads, (double)nthreads * iterations / seconds,
+            (double)backoffs / ((double)nthreads * iterations));
+    }
+
+    return 0;
+}
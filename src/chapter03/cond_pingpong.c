@@ -0,0 +1,206 @@
+#include <pthread.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "errors.h"
+#include "fcond.h"
+
+#define HANDOFFS    100000
+#define WAITERS     8
+#define ROUNDS      5000
+#define SIGNALS     1000000
+
+typedef struct pingpong_tag {
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+    fmutex_t            fmutex;
+    fcond_t             fcond;
+    int                 futex;
+    int                 turn;
+    int                 tokens;
+    long                consumed;
+    int                 quit;
+} pingpong_t;
+
+pingpong_t data = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    FMUTEX_INITIALIZER, FCOND_INITIALIZER, 0, 0, 0, 0, 0};
+
+long now_nsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+long switches(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+void lock(void)
+{
+    if (data.futex)
+        fmutex_lock(&data.fmutex);
+    else
+        pthread_mutex_lock(&data.mutex);
+}
+
+void unlock(void)
+{
+    if (data.futex)
+        fmutex_unlock(&data.fmutex);
+    else
+        pthread_mutex_unlock(&data.mutex);
+}
+
+void wait_cond(void)
+{
+    if (data.futex)
+        fcond_wait(&data.fcond, &data.fmutex);
+    else
+        pthread_cond_wait(&data.cond, &data.mutex);
+}
+
+void wake_cond(int count)
+{
+    if (data.futex)
+        fcond_wake(&data.fcond, count);
+    else if (count >= WAITERS)
+        pthread_cond_broadcast(&data.cond);
+    else
+        while (count-- > 0)
+            pthread_cond_signal(&data.cond);
+}
+
+/*
+ * Two threads take turns, as cond.c does once: each waits for its
+ * turn, passes it on and signals.
+ */
+void *pingpong_thread(void *arg)
+{
+    int self = (int)(long)arg, count;
+
+    for (count = 0; count < HANDOFFS / 2; count++) {
+        lock();
+        while (data.turn != self)
+            wait_cond();
+        data.turn = !self;
+        wake_cond(1);
+        unlock();
+    }
+    return NULL;
+}
+
+void pingpong(int futex)
+{
+    pthread_t threads[2];
+    long start, csw;
+    int count, status;
+
+    data.futex = futex;
+    data.turn = 0;
+    csw = switches();
+    start = now_nsec();
+    for (count = 0; count < 2; count++) {
+        status = pthread_create(&threads[count], NULL, pingpong_thread, (void *)(long)count);
+        if (status != 0)
+            err_abort(status, "Create ping-pong thread");
+    }
+    for (count = 0; count < 2; count++)
+        pthread_join(threads[count], NULL);
+
+    printf("%-24s %10.0f ns/handoff %8.2f switches/handoff\n",
+        futex ? "ping-pong fcond" : "ping-pong pthread_cond",
+        (double)(now_nsec() - start) / HANDOFFS, (double)(switches() - csw) / HANDOFFS);
+}
+
+/*
+ * Waiters each take one token per wakeup; the main thread hands out k
+ * tokens per round while holding the mutex and wakes k waiters.
+ */
+void *token_thread(void *arg)
+{
+    lock();
+    while (1) {
+        while (data.tokens == 0 && !data.quit)
+            wait_cond();
+        if (data.tokens == 0)
+            break;
+        data.tokens--;
+        data.consumed++;
+    }
+    unlock();
+    return NULL;
+}
+
+void tokens(int futex, int k)
+{
+    pthread_t threads[WAITERS];
+    long start, csw;
+    int count, status;
+
+    data.futex = futex;
+    data.tokens = 0;
+    data.consumed = 0;
+    data.quit = 0;
+    for (count = 0; count < WAITERS; count++) {
+        status = pthread_create(&threads[count], NULL, token_thread, NULL);
+        if (status != 0)
+            err_abort(status, "Create token thread");
+    }
+
+    csw = switches();
+    start = now_nsec();
+    for (count = 0; count < ROUNDS; count++) {
+        lock();
+        data.tokens += k;
+        wake_cond(k);
+        unlock();
+        while (__atomic_load_n(&data.consumed, __ATOMIC_RELAXED) < (long)(count + 1) * k)
+            sched_yield();
+    }
+    printf("%-24s %10.0f ns/round   %8.2f switches/round (wake %d of %d)\n",
+        futex ? "tokens fcond" : "tokens pthread_cond",
+        (double)(now_nsec() - start) / ROUNDS, (double)(switches() - csw) / ROUNDS,
+        k, WAITERS);
+
+    lock();
+    data.quit = 1;
+    wake_cond(WAITERS);
+    unlock();
+    for (count = 0; count < WAITERS; count++)
+        pthread_join(threads[count], NULL);
+}
+
+void idle_signal(int futex)
+{
+    long start;
+    int count;
+
+    start = now_nsec();
+    for (count = 0; count < SIGNALS; count++) {
+        if (futex)
+            fcond_signal(&data.fcond);
+        else
+            pthread_cond_signal(&data.cond);
+    }
+    printf("%-24s %10.2f ns/signal\n", futex ? "no waiters fcond" : "no waiters pthread_cond",
+        (double)(now_nsec() - start) / SIGNALS);
+}
+
+int main(int argc, char *argv[])
+{
+    int futex, k;
+
+    for (futex = 0; futex < 2; futex++)
+        pingpong(futex);
+    for (k = 1; k <= WAITERS; k *= 2)
+        for (futex = 0; futex < 2; futex++)
+            tokens(futex, k);
+    for (futex = 0; futex < 2; futex++)
+        idle_signal(futex);
+    return 0;
+}
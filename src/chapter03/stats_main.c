@@ -0,0 +1,84 @@
+#include <pthread.h>
+#include <time.h>
+#include "stats.h"
+#include "errors.h"
+
+#define SPIN    10000000
+#define SECONDS 10
+
+stats_counter_t counter;
+stats_histogram_t spin_time;
+time_t end_time;
+
+uint64_t now_nsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void *counter_thread(void *arg)
+{
+    uint64_t start;
+    int spin;
+
+    while (time(NULL) < end_time)
+    {
+        start = now_nsec();
+        for (spin = 0; spin < SPIN; spin++)
+            stats_counter_inc(&counter);
+        stats_histogram_record(&spin_time, now_nsec() - start);
+
+        sleep(1);
+    }
+
+    printf("Counter is %ld\n", stats_counter_read(&counter));
+    return NULL;
+}
+
+void *monitor_thread(void *arg)
+{
+    int samples = 0;
+
+    while (time(NULL) < end_time)
+    {
+        sleep(3);
+        samples++;
+        printf("Counter is %ld, spin p50 <= %llu ns\n",
+            stats_counter_read(&counter) / SPIN,
+            (unsigned long long)stats_histogram_percentile(&spin_time, 50.0));
+    }
+
+    printf("Monitor thread took %d samples without blocking the counter.\n", samples);
+    return NULL;
+}
+
+int main()
+{
+    int status;
+    pthread_t counter_thread_id;
+    pthread_t monitor_thread_id;
+
+    stats_counter_init(&counter);
+    stats_histogram_init(&spin_time);
+    end_time = time(NULL) + SECONDS;
+
+    status = pthread_create(&counter_thread_id, NULL, counter_thread, NULL);
+    if (status != 0)
+        err_abort(status, "Create counter thread");
+
+    status = pthread_create(&monitor_thread_id, NULL, monitor_thread, NULL);
+    if (status != 0)
+        err_abort(status, "Create monitor thread");
+
+    status = pthread_join(counter_thread_id, NULL);
+    if (status != 0)
+        err_abort(status, "Join counter thread");
+
+    status = pthread_join(monitor_thread_id, NULL);
+    if (status != 0)
+        err_abort(status, "Join monitor thread");
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <pthread.h>
+#include "timer.h"
+#include "errors.h"
+
+#define TIMERS      100000
+#define SPREAD_NSEC (10 * TIMER_NSEC_PER_MSEC)
+
+timer_service_t service;
+int timers = TIMERS;
+uint64_t slack = 0;
+unsigned long fired = 0;
+
+void bench_callback(void *arg)
+{
+    __sync_fetch_and_add(&fired, 1);
+}
+
+void *producer_routine(void *arg)
+{
+    uint64_t base;
+    unsigned int seed = (unsigned int)(unsigned long)arg;
+    int count, status;
+
+    base = timer_now() + SPREAD_NSEC;
+    for (count = 0; count < timers; count++) {
+        status = timer_schedule_slack(&service, base + rand_r(&seed) % SPREAD_NSEC,
+            slack, bench_callback, NULL, NULL);
+        if (status != 0)
+            err_abort(status, "Schedule timer");
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t *producers;
+    timer_stats_t stats;
+    uint64_t start, inserted, done;
+    unsigned long total;
+    int shards = 1, nproducers = 1, workers = 2;
+    int count, status;
+
+    if (argc > 1)
+        shards = atoi(argv[1]);
+    if (argc > 2)
+        nproducers = atoi(argv[2]);
+    if (argc > 3)
+        timers = atoi(argv[3]);
+    if (argc > 4)
+        slack = strtoull(argv[4], NULL, 0) * 1000;
+
+    status = timer_service_init(&service, shards, workers);
+    if (status != 0)
+        err_abort(status, "Init timer service");
+
+    producers = (pthread_t *)malloc(nproducers * sizeof(pthread_t));
+    if (producers == NULL)
+        errno_abort("Allocate producers");
+
+    start = timer_now();
+    for (count = 0; count < nproducers; count++) {
+        status = pthread_create(&producers[count], NULL,
+            producer_routine, (void *)(unsigned long)(count + 1));
+        if (status != 0)
+            err_abort(status, "Create producer");
+    }
+
+    for (count = 0; count < nproducers; count++) {
+        status = pthread_join(producers[count], NULL);
+        if (status != 0)
+            err_abort(status, "Join producer");
+    }
+    inserted = timer_now();
+
+    total = (unsigned long)nproducers * timers;
+    while (__sync_fetch_and_add(&fired, 0) < total)
+        sched_yield();
+    done = timer_now();
+
+    printf("%d shards, %d producers: %lu timers\n", shards, nproducers, total);
+    printf("insert: %.0f timers/sec\n",
+        total / ((double)(inserted - start) / TIMER_NSEC_PER_SEC));
+    printf("insert+fire: %.0f timers/sec\n",
+        total / ((double)(done - start) / TIMER_NSEC_PER_SEC));
+
+    for (count = 0; count < shards; count++) {
+        status = timer_shard_stats(&service, count, &stats);
+        if (status != 0)
+            err_abort(status, "Shard stats");
+        printf("shard %02d: depth %d, inserted %lu, fired %lu, "
+            "wakeups %lu (%.4f per timer), lag avg %lu us, max %lu us\n",
+            count, stats.depth, stats.inserted, stats.fired, stats.wakeups,
+            stats.fired ? (double)stats.wakeups / stats.fired : 0.0,
+            stats.fired ? (unsigned long)(stats.lag_total / stats.fired / 1000) : 0UL,
+            (unsigned long)(stats.lag_max / 1000));
+    }
+
+    status = timer_service_destroy(&service);
+    if (status != 0)
+        err_abort(status, "Destroy timer service");
+
+    free(producers);
+    return 0;
+}
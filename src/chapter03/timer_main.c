@@ -0,0 +1,75 @@
+#include <pthread.h>
+#include "timer.h"
+#include "errors.h"
+
+#define SHARDS  2
+#define WORKERS 2
+
+typedef struct alarm_tag {
+    int         msecs;
+    char        message[64];
+} alarm_t;
+
+void alarm_callback(void *arg)
+{
+    alarm_t *alarm = (alarm_t *)arg;
+
+    printf("(%d ms) %s\n", alarm->msecs, alarm->message);
+    free(alarm);
+}
+
+int main(int argc, char *argv[])
+{
+    timer_service_t service;
+    timer_id_t id;
+    alarm_t *alarm;
+    char line[128];
+    int status;
+
+    status = timer_service_init(&service, SHARDS, WORKERS);
+    if (status != 0)
+        err_abort(status, "Init timer service");
+
+    while (1) {
+        printf("Alarm> ");
+
+        if (fgets(line, sizeof(line), stdin) == NULL)
+            break;
+
+        if (strlen(line) <= 1)
+            continue;
+
+        if (sscanf(line, "cancel %lu", &id) == 1) {
+            status = timer_cancel(&service, id, (void **)&alarm);
+            if (status == ENOENT)
+                fprintf(stderr, "No pending alarm %lu\n", id);
+            else if (status != 0)
+                err_abort(status, "Cancel alarm");
+            else
+                free(alarm);
+            continue;
+        }
+
+        alarm = (alarm_t *)malloc(sizeof(alarm_t));
+        if (alarm == NULL)
+            errno_abort("Allocate alarm");
+
+        if (sscanf(line, "%d %63[^\n]", &alarm->msecs, alarm->message) < 2) {
+            fprintf(stderr, "Bad command\n");
+            free(alarm);
+            continue;
+        }
+
+        status = timer_schedule(&service,
+            timer_now() + alarm->msecs * TIMER_NSEC_PER_MSEC,
+            alarm_callback, alarm, &id);
+        if (status != 0)
+            err_abort(status, "Schedule alarm");
+        printf("alarm %lu scheduled\n", id);
+    }
+
+    status = timer_service_destroy(&service);
+    if (status != 0)
+        err_abort(status, "Destroy timer service");
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include <time.h>
+#include "pipeline.h"
+#include "errors.h"
+
+#define ROW_WIDTH   1024
+#define ROW_SLOTS   (PIPELINE_POOL * PIPELINE_BATCH)
+
+typedef struct row_tag {
+    unsigned long   number;
+    unsigned char   pixels[ROW_WIDTH];
+} row_t;
+
+typedef struct source_tag {
+    row_t           *rows;
+    unsigned long   next;
+    unsigned long   total;
+} source_t;
+
+typedef struct sink_tag {
+    unsigned long   expected;
+    unsigned long   checksum;
+    int             out_of_order;
+} sink_t;
+
+unsigned char gamma_table[256];
+
+/*
+ * Reuses row slots round robin; a slot cannot be overwritten while in
+ * flight because at most PIPELINE_POOL batches exist at once.
+ */
+int scan_rows(void *arg, void **items, int max)
+{
+    source_t *source = (source_t *)arg;
+    row_t *row;
+    int count, column;
+
+    for (count = 0; count < max && source->next < source->total; count++, source->next++) {
+        row = &source->rows[source->next % ROW_SLOTS];
+        row->number = source->next;
+        for (column = 0; column < ROW_WIDTH; column++)
+            row->pixels[column] = (unsigned char)(source->next * 7 + column * 13);
+        items[count] = row;
+    }
+    return count;
+}
+
+int blur_rows(void *arg, void **items, int *count)
+{
+    unsigned char line[ROW_WIDTH];
+    row_t *row;
+    int index, column;
+
+    for (index = 0; index < *count; index++) {
+        row = (row_t *)items[index];
+        line[0] = row->pixels[0];
+        line[ROW_WIDTH - 1] = row->pixels[ROW_WIDTH - 1];
+        for (column = 1; column < ROW_WIDTH - 1; column++)
+            line[column] = (row->pixels[column - 1] + 2 * row->pixels[column]
+                + row->pixels[column + 1]) / 4;
+        memcpy(row->pixels, line, ROW_WIDTH);
+    }
+    return 0;
+}
+
+int gamma_rows(void *arg, void **items, int *count)
+{
+    row_t *row;
+    int index, column;
+
+    for (index = 0; index < *count; index++) {
+        row = (row_t *)items[index];
+        for (column = 0; column < ROW_WIDTH; column++)
+            row->pixels[column] = gamma_table[row->pixels[column]];
+    }
+    return 0;
+}
+
+int collect_rows(void *arg, void **items, int *count)
+{
+    sink_t *sink = (sink_t *)arg;
+    row_t *row;
+    int index, column;
+
+    for (index = 0; index < *count; index++) {
+        row = (row_t *)items[index];
+        if (row->number != sink->expected++)
+            sink->out_of_order++;
+        for (column = 0; column < ROW_WIDTH; column++)
+            sink->checksum = sink->checksum * 31 + row->pixels[column];
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    pipeline_t pipeline;
+    pipeline_stats_t stats;
+    source_t source;
+    sink_t sink = {0, 0, 0};
+    double seconds;
+    int blur_threads = 2, gamma_threads = 2, index, status;
+
+    if (argc > 1)
+        blur_threads = atoi(argv[1]);
+    if (argc > 2)
+        gamma_threads = atoi(argv[2]);
+    source.total = (argc > 3) ? atol(argv[3]) : 500000;
+    source.next = 0;
+
+    for (index = 0; index < 256; index++)
+        gamma_table[index] = (unsigned char)(255.0 * (index / 255.0) * (index / 255.0));
+
+    source.rows = (row_t *)malloc(ROW_SLOTS * sizeof(row_t));
+    if (source.rows == NULL)
+        errno_abort("Allocate rows");
+
+    status = pipeline_init(&pipeline, scan_rows, &source);
+    if (status != 0)
+        err_abort(status, "Init pipeline");
+    status = pipeline_stage(&pipeline, "blur", blur_threads, PIPELINE_UNORDERED, blur_rows, NULL);
+    if (status != 0)
+        err_abort(status, "Add blur stage");
+    status = pipeline_stage(&pipeline, "gamma", gamma_threads, PIPELINE_UNORDERED, gamma_rows, NULL);
+    if (status != 0)
+        err_abort(status, "Add gamma stage");
+    status = pipeline_stage(&pipeline, "collect", 1, PIPELINE_ORDERED, collect_rows, &sink);
+    if (status != 0)
+        err_abort(status, "Add collect stage");
+
+    status = pipeline_run(&pipeline);
+    if (status != 0)
+        err_abort(status, "Run pipeline");
+
+    seconds = pipeline.elapsed / 1e9;
+    printf("%lu rows in %.3f s: %.0f rows/s, %.1f MB/s, %d out of order, checksum %lx\n",
+        sink.expected, seconds, sink.expected / seconds,
+        sink.expected * (double)ROW_WIDTH / seconds / 1e6, sink.out_of_order, sink.checksum);
+
+    printf("%-8s %4s %10s %8s %10s %10s\n", "stage", "par", "batches", "util", "idle ms", "stall ms");
+    for (index = 0; index < pipeline.nstages; index++) {
+        pipeline_stats(&pipeline, index, &stats);
+        printf("%-8s %4d %10lu %7.1f%% %10.1f %10.1f\n", pipeline.stages[index].name,
+            stats.parallelism, stats.batches, stats.utilization * 100,
+            stats.idle / 1e6, stats.stalled / 1e6);
+    }
+
+    pipeline_destroy(&pipeline);
+    free(source.rows);
+    return 0;
+}
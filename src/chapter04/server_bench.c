@@ -0,0 +1,177 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "server.h"
+#include "errors.h"
+
+#define MAX_CLIENTS 16
+#define KEYS        1024
+#define DEPTH       32
+#define BATCH       32
+
+#define OP_ADD      1
+
+typedef struct table_tag {
+    long        values[KEYS];
+} table_t;
+
+typedef struct client_tag {
+    pthread_t   thread_id;
+    int         number;
+    long        checksum;
+} client_t;
+
+server_t server;
+table_t table;
+int requests, mode;
+
+uint64_t now_nsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/*
+ * Only server threads touch the table; the atomic add only matters
+ * when the server runs more than one thread.
+ */
+int table_handler(void *arg, server_request_t *request)
+{
+    table_t *table = (table_t *)arg;
+    long key = (long)request->arg;
+
+    if (request->op != OP_ADD)
+        return EINVAL;
+    request->result = __atomic_add_fetch(&table->values[key % KEYS], 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void run_sync(client_t *self)
+{
+    long result;
+    int count, status;
+
+    for (count = 0; count < requests; count++) {
+        status = server_call(&server, OP_ADD, (void *)(long)(self->number + count), &result);
+        if (status != 0)
+            err_abort(status, "Call server");
+        self->checksum += result;
+    }
+}
+
+void run_pipelined(client_t *self)
+{
+    server_request_t slots[DEPTH], *done, *next;
+    server_mailbox_t mailbox;
+    int sent = 0, received = 0, count, status;
+
+    server_mailbox_init(&mailbox);
+    for (count = 0; count < DEPTH && sent < requests; count++, sent++) {
+        server_request_init(&slots[count], OP_ADD, (void *)(long)(self->number + sent));
+        status = server_send(&server, &slots[count], &mailbox);
+        if (status != 0)
+            err_abort(status, "Send request");
+    }
+
+    while (received < requests) {
+        for (done = server_mailbox_take(&mailbox, 1); done != NULL; done = next) {
+            next = done->link;
+            self->checksum += done->result;
+            received++;
+            if (sent < requests) {
+                server_request_init(done, OP_ADD, (void *)(long)(self->number + sent++));
+                status = server_send(&server, done, &mailbox);
+                if (status != 0)
+                    err_abort(status, "Send request");
+            }
+        }
+    }
+}
+
+void run_batched(client_t *self)
+{
+    server_request_t slots[BATCH], *batch[BATCH], *done;
+    server_mailbox_t mailbox;
+    int sent = 0, count, size, received, status;
+
+    server_mailbox_init(&mailbox);
+    while (sent < requests) {
+        size = requests - sent < BATCH ? requests - sent : BATCH;
+        for (count = 0; count < size; count++) {
+            server_request_init(&slots[count], OP_ADD, (void *)(long)(self->number + sent++));
+            batch[count] = &slots[count];
+        }
+        status = server_send_batch(&server, batch, size, &mailbox);
+        if (status != 0)
+            err_abort(status, "Send batch");
+
+        for (received = 0; received < size;) {
+            for (done = server_mailbox_take(&mailbox, 1); done != NULL; done = done->link) {
+                self->checksum += done->result;
+                received++;
+            }
+        }
+    }
+}
+
+void *client_routine(void *arg)
+{
+    client_t *self = (client_t *)arg;
+
+    if (mode == 0)
+        run_sync(self);
+    else if (mode == 1)
+        run_pipelined(self);
+    else
+        run_batched(self);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *names[] = {"sync", "pipelined", "batched"};
+    client_t clients[MAX_CLIENTS];
+    uint64_t start, elapsed;
+    int nclients = 4, servers = 1, count, status;
+
+    if (argc > 1)
+        nclients = atoi(argv[1]);
+    if (argc > 2)
+        servers = atoi(argv[2]);
+    requests = (argc > 3) ? atoi(argv[3]) : 100000;
+    if (nclients < 1 || nclients > MAX_CLIENTS)
+        nclients = 4;
+
+    printf("%d clients, %d server threads, %d requests each\n", nclients, servers, requests);
+    for (mode = 0; mode < 3; mode++) {
+        memset(&table, 0, sizeof(table));
+        status = server_init(&server, servers, table_handler, &table);
+        if (status != 0)
+            err_abort(status, "Init server");
+
+        start = now_nsec();
+        for (count = 0; count < nclients; count++) {
+            clients[count].number = count;
+            clients[count].checksum = 0;
+            status = pthread_create(&clients[count].thread_id, NULL, client_routine, &clients[count]);
+            if (status != 0)
+                err_abort(status, "Create client");
+        }
+        for (count = 0; count < nclients; count++) {
+            status = pthread_join(clients[count].thread_id, NULL);
+            if (status != 0)
+                err_abort(status, "Join client");
+        }
+        elapsed = now_nsec() - start;
+
+        status = server_destroy(&server);
+        if (status != 0)
+            err_abort(status, "Destroy server");
+
+        printf("%-10s %12.0f requests/s %10.2f us/request per client\n", names[mode],
+            (double)nclients * requests / (elapsed / 1e9), elapsed / 1e3 / requests);
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include <pthread.h>
+#include <time.h>
+#include "token.h"
+#include "errors.h"
+
+#define ITERATIONS  100000000
+#define TRIALS      20
+
+token_t team_token;
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t cv = PTHREAD_COND_INITIALIZER;
+volatile unsigned long sink;
+
+uint64_t now_nsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void bench_checks(void)
+{
+    uint64_t start, base, testcancel, token;
+    token_t local;
+    long count;
+    int status;
+
+    status = token_init(&local, NULL);
+    if (status != 0)
+        err_abort(status, "Init token");
+
+    start = now_nsec();
+    for (count = 0; count < ITERATIONS; count++)
+        sink += count;
+    base = now_nsec() - start;
+
+    start = now_nsec();
+    for (count = 0; count < ITERATIONS; count++) {
+        sink += count;
+        pthread_testcancel();
+    }
+    testcancel = now_nsec() - start;
+
+    start = now_nsec();
+    for (count = 0; count < ITERATIONS; count++) {
+        sink += count;
+        if (token_cancelled(&local))
+            break;
+    }
+    token = now_nsec() - start;
+
+    printf("check overhead: pthread_testcancel %.2f ns, token_cancelled %.2f ns\n",
+        (double)(testcancel - base) / ITERATIONS, (double)(token - base) / ITERATIONS);
+    token_destroy(&local);
+}
+
+void *spin_testcancel(void *arg)
+{
+    unsigned long count;
+
+    for (count = 0; ; count++) {
+        sink += count;
+        if (count % 1000 == 0)
+            pthread_testcancel();
+    }
+    return NULL;
+}
+
+void *spin_token(void *arg)
+{
+    token_t *token = (token_t *)arg;
+    unsigned long count;
+
+    for (count = 0; !token_cancelled(token); count++)
+        sink += count;
+    return NULL;
+}
+
+void unlock_mutex(void *arg)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)arg);
+}
+
+void *wait_testcancel(void *arg)
+{
+    pthread_mutex_lock(&mutex);
+    pthread_cleanup_push(unlock_mutex, &mutex);
+    while (1)
+        pthread_cond_wait(&cv, &mutex);
+    pthread_cleanup_pop(1);
+    return NULL;
+}
+
+void *wait_token(void *arg)
+{
+    token_t *token = (token_t *)arg;
+
+    pthread_mutex_lock(&mutex);
+    while (token_cond_wait(token, &cv, &mutex) != ECANCELED)
+        ;
+    pthread_mutex_unlock(&mutex);
+    return NULL;
+}
+
+void *sleep_token(void *arg)
+{
+    token_sleep((token_t *)arg, 60 * 1000000000ULL);
+    return NULL;
+}
+
+/*
+ * Measures from the cancel request until join returns. Token workers
+ * are children of team_token, so cancelling the team stops them.
+ */
+double latency(void *(*routine)(void *), int use_token)
+{
+    struct timespec settle = {0, 10000000};
+    pthread_t thread;
+    token_t token;
+    uint64_t total = 0, start;
+    int trial, status;
+
+    for (trial = 0; trial < TRIALS; trial++) {
+        status = token_init(&team_token, NULL);
+        if (status != 0)
+            err_abort(status, "Init team token");
+        status = token_init(&token, &team_token);
+        if (status != 0)
+            err_abort(status, "Init token");
+
+        status = pthread_create(&thread, NULL, routine, &token);
+        if (status != 0)
+            err_abort(status, "Create thread");
+        nanosleep(&settle, NULL);
+
+        start = now_nsec();
+        if (use_token)
+            status = token_cancel(&team_token);
+        else
+            status = pthread_cancel(thread);
+        if (status != 0)
+            err_abort(status, "Cancel");
+
+        status = pthread_join(thread, NULL);
+        if (status != 0)
+            err_abort(status, "Join thread");
+        total += now_nsec() - start;
+
+        token_destroy(&token);
+        token_destroy(&team_token);
+    }
+    return (double)total / TRIALS / 1000.0;
+}
+
+int main(int argc, char *argv[])
+{
+    bench_checks();
+
+    printf("spinning worker: pthread_cancel %.1f us, token_cancel %.1f us\n",
+        latency(spin_testcancel, 0), latency(spin_token, 1));
+    printf("waiting worker:  pthread_cancel %.1f us, token_cancel %.1f us\n",
+        latency(wait_testcancel, 0), latency(wait_token, 1));
+    printf("sleeping worker: token_cancel %.1f us\n", latency(sleep_token, 1));
+    return 0;
+}
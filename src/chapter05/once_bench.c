@@ -0,0 +1,129 @@
+#include <pthread.h>
+#include <time.h>
+#include "lazy.h"
+#include "errors.h"
+
+#define THREADS     8
+#define ROUNDS      64
+#define CALLS       100000
+
+typedef struct config_tag {
+    int         attempts;
+    int         threads;
+} config_t;
+
+pthread_once_t pthread_controls[ROUNDS];
+once_t lazy_controls[ROUNDS];
+long pthread_inits, lazy_inits;
+pthread_barrier_t started;
+int use_lazy;
+
+double elapsed_nsec(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+void pthread_init_routine(void)
+{
+    __atomic_fetch_add(&pthread_inits, 1, __ATOMIC_RELAXED);
+}
+
+int lazy_init_routine(void *arg, void **value)
+{
+    __atomic_fetch_add(&lazy_inits, 1, __ATOMIC_RELAXED);
+    *value = arg;
+    return 0;
+}
+
+/*
+ * Fails on the first attempt so the second caller has to retry.
+ */
+int config_init(config_t *config)
+{
+    static int calls = 0;
+
+    if (calls++ == 0)
+        return EAGAIN;
+    config->attempts = calls;
+    config->threads = THREADS;
+    return 0;
+}
+
+LAZY_STATIC(config_t, shared_config, config_init)
+
+void *thread_routine(void *arg)
+{
+    void *value;
+    int round, count, status;
+
+    for (round = 0; round < ROUNDS; round++) {
+        pthread_barrier_wait(&started);
+        for (count = 0; count < CALLS; count++) {
+            if (use_lazy) {
+                status = once_call(&lazy_controls[round], lazy_init_routine, arg, &value);
+                if (status != 0)
+                    err_abort(status, "Once call");
+            } else {
+                status = pthread_once(&pthread_controls[round], pthread_init_routine);
+                if (status != 0)
+                    err_abort(status, "Pthread once");
+            }
+        }
+    }
+    return NULL;
+}
+
+void bench(int lazy)
+{
+    pthread_t threads[THREADS];
+    struct timespec start;
+    int count, status;
+
+    use_lazy = lazy;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (count = 0; count < THREADS; count++) {
+        status = pthread_create(&threads[count], NULL, thread_routine, NULL);
+        if (status != 0)
+            err_abort(status, "Create thread");
+    }
+    for (count = 0; count < THREADS; count++) {
+        status = pthread_join(threads[count], NULL);
+        if (status != 0)
+            err_abort(status, "Join thread");
+    }
+    printf("%-14s %.2f ns/call, %ld inits\n",
+        lazy ? "once_call:" : "pthread_once:",
+        elapsed_nsec(&start) / ((double)THREADS * ROUNDS * CALLS),
+        lazy ? lazy_inits : pthread_inits);
+}
+
+int main(int argc, char *argv[])
+{
+    config_t *config;
+    int count, status;
+
+    for (count = 0; count < ROUNDS; count++) {
+        pthread_controls[count] = (pthread_once_t)PTHREAD_ONCE_INIT;
+        lazy_controls[count] = (once_t)ONCE_INITIALIZER;
+    }
+
+    status = pthread_barrier_init(&started, NULL, THREADS);
+    if (status != 0)
+        err_abort(status, "Init barrier");
+
+    bench(0);
+    bench(1);
+
+    if (shared_config() != NULL)
+        printf("Unexpected success on first attempt\n");
+    config = shared_config();
+    if (config == NULL)
+        err_abort(EAGAIN, "Config retry");
+    printf("config initialized after %d attempts\n", config->attempts);
+
+    pthread_barrier_destroy(&started);
+    return 0;
+}
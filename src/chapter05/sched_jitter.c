@@ -0,0 +1,138 @@
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "errors.h"
+#include "schedprof.h"
+
+#define MAX_SAMPLES 100000
+
+typedef struct jitter_tag {
+    int         profile;
+    int         policy;
+    long        interval;
+    long        duration;
+    long        count;
+    long        missed;
+    long        samples[MAX_SAMPLES];
+} jitter_t;
+
+static volatile int hog_quit = 0;
+
+static long now_nsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+static void *hog_routine(void *arg)
+{
+    while (!hog_quit)
+        ;
+    return NULL;
+}
+
+/*
+ * Sleeps until each absolute deadline and records how late the wakeup
+ * was. Periods that have already passed are counted as missed, so a
+ * starved profile still finishes in the given duration.
+ */
+static void *jitter_routine(void *arg)
+{
+    jitter_t *jitter = (jitter_t *)arg;
+    struct sched_param param;
+    struct timespec wakeup;
+    long start, deadline, now;
+
+    pthread_getschedparam(pthread_self(), &jitter->policy, &param);
+
+    start = now_nsec();
+    for (deadline = start + jitter->interval; deadline < start + jitter->duration
+        && jitter->count < MAX_SAMPLES; deadline += jitter->interval) {
+        wakeup.tv_sec = deadline / 1000000000L;
+        wakeup.tv_nsec = deadline % 1000000000L;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, NULL) == EINTR)
+            ;
+        now = now_nsec();
+        jitter->samples[jitter->count++] = now - deadline;
+        while (deadline + jitter->interval < now) {
+            deadline += jitter->interval;
+            jitter->missed++;
+        }
+    }
+    return NULL;
+}
+
+static int compare_long(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[])
+{
+    static jitter_t jitter;
+    pthread_t *hogs, thread_id;
+    long hog_count = sysconf(_SC_NPROCESSORS_ONLN);
+    double seconds = 1.0;
+    long interval_usec = 1000;
+    int profile, degraded, status, count;
+
+    if (argc > 1)
+        seconds = atof(argv[1]);
+    if (argc > 2)
+        interval_usec = atol(argv[2]);
+    if (argc > 3)
+        hog_count = atol(argv[3]);
+    if (seconds <= 0 || interval_usec <= 0 || hog_count < 0) {
+        fprintf(stderr, "usage: %s [seconds] [interval usec] [hogs]\n", argv[0]);
+        return 2;
+    }
+
+    hogs = (pthread_t *)malloc((hog_count + 1) * sizeof(pthread_t));
+    if (hogs == NULL)
+        errno_abort("Allocate hogs");
+    for (count = 0; count < hog_count; count++) {
+        status = pthread_create(&hogs[count], NULL, hog_routine, NULL);
+        if (status != 0)
+            err_abort(status, "Create hog");
+    }
+
+    printf("%ld CPU hogs, %ld us period, %.1f s per profile\n",
+        hog_count, interval_usec, seconds);
+    printf("%-11s %-6s %8s %7s %10s %10s %10s %10s\n", "profile", "policy",
+        "wakeups", "missed", "min us", "p50 us", "p99 us", "max us");
+
+    for (profile = SCHEDPROF_DEFAULT; profile <= SCHEDPROF_BACKGROUND; profile++) {
+        memset(&jitter, 0, sizeof(jitter));
+        jitter.profile = profile;
+        jitter.interval = interval_usec * 1000L;
+        jitter.duration = (long)(seconds * 1e9);
+
+        status = schedprof_create(&thread_id, NULL, profile, 0,
+            jitter_routine, &jitter, &degraded);
+        if (status != 0)
+            err_abort(status, "Create jitter thread");
+        status = pthread_join(thread_id, NULL);
+        if (status != 0)
+            err_abort(status, "Join jitter thread");
+
+        qsort(jitter.samples, jitter.count, sizeof(long), compare_long);
+        printf("%-11s %-6s %8ld %7ld %10.1f %10.1f %10.1f %10.1f%s\n",
+            schedprof_name(profile), schedprof_policy_name(jitter.policy),
+            jitter.count, jitter.missed,
+            jitter.count ? jitter.samples[0] / 1e3 : 0,
+            jitter.count ? jitter.samples[jitter.count / 2] / 1e3 : 0,
+            jitter.count ? jitter.samples[jitter.count * 99 / 100] / 1e3 : 0,
+            jitter.count ? jitter.samples[jitter.count - 1] / 1e3 : 0,
+            degraded ? "  (degraded)" : "");
+    }
+
+    hog_quit = 1;
+    for (count = 0; count < hog_count; count++)
+        pthread_join(hogs[count], NULL);
+    free(hogs);
+    return 0;
+}
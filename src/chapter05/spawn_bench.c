@@ -0,0 +1,206 @@
+#include <pthread.h>
+#include <time.h>
+#include "spawnpool.h"
+#include "errors.h"
+
+#define ITERATIONS  2000
+#define RESIDENT    64
+#define SMALL_STACK (64 * 1024)
+#define TOUCH       (16 * 1024)
+
+typedef struct config_tag {
+    const char  *name;
+    int         pooled;
+    size_t      stack_size;
+    size_t      guard_size;
+    int         max_cached;
+    int         flags;
+} config_t;
+
+static config_t configs[] = {
+    {"pthread default",         0, 0,           0,    0,  0},
+    {"pthread 64K",             0, SMALL_STACK, 0,    0,  0},
+    {"spawn 64K uncached",      1, SMALL_STACK, 4096, 0,  0},
+    {"spawn 64K cached",        1, SMALL_STACK, 4096, 64, 0},
+    {"spawn 64K no guard",      1, SMALL_STACK, 0,    64, 0},
+    {"spawn 64K prefault",      1, SMALL_STACK, 4096, 64, SPAWN_PREFAULT},
+};
+
+static pthread_barrier_t hold;
+static long samples[ITERATIONS];
+
+static long now_nsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+static void *empty_routine(void *arg)
+{
+    return arg;
+}
+
+/*
+ * Uses TOUCH bytes of stack, then waits so that every thread is alive
+ * when the resident set is sampled.
+ */
+static void *resident_routine(void *arg)
+{
+    volatile char frame[TOUCH];
+    int count;
+
+    for (count = 0; count < TOUCH; count += 1024)
+        frame[count] = 1;
+    pthread_barrier_wait(&hold);
+    pthread_barrier_wait(&hold);
+    return (void *)(long)frame[0];
+}
+
+static void statm(long *size, long *resident)
+{
+    FILE *file = fopen("/proc/self/statm", "r");
+
+    *size = *resident = 0;
+    if (file == NULL)
+        return;
+    if (fscanf(file, "%ld %ld", size, resident) != 2)
+        *size = *resident = 0;
+    fclose(file);
+}
+
+static int compare_long(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int create(config_t *config, spawn_pool_t *pool, pthread_attr_t *attr,
+    void *(*routine)(void *), pthread_t *thread, spawn_thread_t **spawned)
+{
+    if (config->pooled)
+        return spawn_create(pool, spawned, routine, NULL);
+    return pthread_create(thread, config->stack_size ? attr : NULL, routine, NULL);
+}
+
+static int join(config_t *config, pthread_t thread, spawn_thread_t *spawned)
+{
+    if (config->pooled)
+        return spawn_join(spawned, NULL);
+    return pthread_join(thread, NULL);
+}
+
+static void run(config_t *config)
+{
+    pthread_t threads[RESIDENT];
+    spawn_thread_t *spawned[RESIDENT];
+    spawn_pool_t pool;
+    pthread_attr_t attr;
+    long page = sysconf(_SC_PAGESIZE);
+    long start, size, resident, size_after, resident_after;
+    int count, status;
+
+    if (config->pooled) {
+        status = spawn_pool_init(&pool, config->stack_size, config->guard_size,
+            config->max_cached, config->flags);
+        if (status != 0)
+            err_abort(status, "Init spawn pool");
+    } else {
+        status = pthread_attr_init(&attr);
+        if (status != 0)
+            err_abort(status, "Init attr");
+        if (config->stack_size) {
+            status = pthread_attr_setstacksize(&attr, config->stack_size);
+            if (status != 0)
+                err_abort(status, "Set stack size");
+        }
+    }
+
+    for (count = 0; count < ITERATIONS; count++) {
+        start = now_nsec();
+        status = create(config, &pool, &attr, empty_routine, &threads[0], &spawned[0]);
+        if (status != 0)
+            err_abort(status, "Create thread");
+        status = join(config, threads[0], spawned[0]);
+        if (status != 0)
+            err_abort(status, "Join thread");
+        samples[count] = now_nsec() - start;
+    }
+    qsort(samples, ITERATIONS, sizeof(long), compare_long);
+
+    status = pthread_barrier_init(&hold, NULL, RESIDENT + 1);
+    if (status != 0)
+        err_abort(status, "Init barrier");
+    statm(&size, &resident);
+    for (count = 0; count < RESIDENT; count++) {
+        status = create(config, &pool, &attr, resident_routine, &threads[count], &spawned[count]);
+        if (status != 0)
+            err_abort(status, "Create resident thread");
+    }
+    pthread_barrier_wait(&hold);
+    statm(&size_after, &resident_after);
+    pthread_barrier_wait(&hold);
+    for (count = 0; count < RESIDENT; count++) {
+        status = join(config, threads[count], spawned[count]);
+        if (status != 0)
+            err_abort(status, "Join resident thread");
+    }
+    pthread_barrier_destroy(&hold);
+
+    printf("%-20s %10.2f %10.2f %10.2f %12.1f %10.1f\n", config->name,
+        samples[ITERATIONS / 2] / 1e3, samples[ITERATIONS * 99 / 100] / 1e3,
+        samples[ITERATIONS - 1] / 1e3,
+        (double)(size_after - size) * page / RESIDENT / 1024,
+        (double)(resident_after - resident) * page / RESIDENT / 1024);
+
+    if (config->pooled) {
+        status = spawn_pool_destroy(&pool);
+        if (status != 0)
+            err_abort(status, "Destroy spawn pool");
+    } else
+        pthread_attr_destroy(&attr);
+}
+
+/*
+ * Detached threads recycle their stacks through the pool as later
+ * spawns reap them.
+ */
+static void run_detached(void)
+{
+    spawn_pool_t pool;
+    long start;
+    int count, status;
+
+    status = spawn_pool_init(&pool, SMALL_STACK, 4096, 64, 0);
+    if (status != 0)
+        err_abort(status, "Init spawn pool");
+
+    start = now_nsec();
+    for (count = 0; count < ITERATIONS; count++) {
+        status = spawn_create(&pool, NULL, empty_routine, NULL);
+        if (status != 0)
+            err_abort(status, "Spawn detached thread");
+    }
+    status = spawn_pool_destroy(&pool);
+    if (status != 0)
+        err_abort(status, "Destroy spawn pool");
+
+    printf("%d detached spawns: %.2f us each\n", ITERATIONS,
+        (now_nsec() - start) / 1e3 / ITERATIONS);
+}
+
+int main(int argc, char *argv[])
+{
+    int count;
+
+    printf("create+join over %d threads, memory over %d live threads using %d KB of stack\n",
+        ITERATIONS, RESIDENT, TOUCH / 1024);
+    printf("%-20s %10s %10s %10s %12s %10s\n", "", "p50 us", "p99 us", "max us",
+        "VSZ KB/thr", "RSS KB/thr");
+    for (count = 0; count < (int)(sizeof(configs) / sizeof(configs[0])); count++)
+        run(&configs[count]);
+    run_detached();
+    return 0;
+}
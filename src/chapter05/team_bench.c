@@ -0,0 +1,99 @@
+#include <pthread.h>
+#include <time.h>
+#include "team.h"
+#include "errors.h"
+
+#define POOL        8
+#define PHASES      20000
+
+volatile long sink;
+
+uint64_t now_nsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+int touch_routine(int index, void *arg, token_t *cancel)
+{
+    __atomic_fetch_add(&sink, index, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void *thread_routine(void *arg)
+{
+    touch_routine((int)(long)arg, NULL, NULL);
+    return NULL;
+}
+
+/*
+ * Index 3 fails; the others spin until the failure cancels them.
+ */
+int failing_routine(int index, void *arg, token_t *cancel)
+{
+    if (index == 3)
+        return EIO;
+    while (!token_cancelled(cancel))
+        sched_yield();
+    return 0;
+}
+
+double bench_create(int n)
+{
+    pthread_t threads[POOL];
+    uint64_t start;
+    int phase, count, status;
+
+    start = now_nsec();
+    for (phase = 0; phase < PHASES / 10; phase++) {
+        for (count = 0; count < n; count++) {
+            status = pthread_create(&threads[count], NULL, thread_routine, (void *)(long)count);
+            if (status != 0)
+                err_abort(status, "Create thread");
+        }
+        for (count = 0; count < n; count++) {
+            status = pthread_join(threads[count], NULL);
+            if (status != 0)
+                err_abort(status, "Join thread");
+        }
+    }
+    return (double)(now_nsec() - start) / (PHASES / 10) / 1000.0;
+}
+
+double bench_team(team_t *team, int n)
+{
+    uint64_t start;
+    int phase, status;
+
+    start = now_nsec();
+    for (phase = 0; phase < PHASES; phase++) {
+        status = team_run(team, n, touch_routine, NULL);
+        if (status != 0)
+            err_abort(status, "Run team");
+    }
+    return (double)(now_nsec() - start) / PHASES / 1000.0;
+}
+
+int main(int argc, char *argv[])
+{
+    team_t team;
+    int n, status;
+
+    status = team_init(&team, POOL - 1);
+    if (status != 0)
+        err_abort(status, "Init team");
+
+    printf("%4s %16s %16s\n", "n", "create/join us", "team_run us");
+    for (n = 1; n <= POOL; n *= 2)
+        printf("%4d %16.2f %16.2f\n", n, bench_create(n), bench_team(&team, n));
+
+    status = team_run(&team, POOL, failing_routine, NULL);
+    printf("failing phase returned %d (%s)\n", status, strerror(status));
+
+    status = team_destroy(&team);
+    if (status != 0)
+        err_abort(status, "Destroy team");
+    return 0;
+}
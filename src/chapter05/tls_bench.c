@@ -0,0 +1,153 @@
+#include <pthread.h>
+#include <time.h>
+#include "tls.h"
+#include "errors.h"
+
+#define THREADS     4
+#define ITERATIONS  50000000
+
+typedef struct private_tag {
+    long        calls;
+} private_t;
+
+pthread_key_t pthread_counter_key;
+tls_key_t tls_counter_key;
+__thread long thread_counter;
+pthread_barrier_t started, sampled;
+
+double elapsed_nsec(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+void private_destructor(void *value)
+{
+    free(value);
+}
+
+void bench_pthread(void)
+{
+    struct timespec start;
+    private_t *private;
+    int count;
+
+    private = (private_t*)calloc(1, sizeof(private_t));
+    if (private == NULL)
+        errno_abort("Allocate private");
+    pthread_setspecific(pthread_counter_key, private);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (count = 0; count < ITERATIONS; count++) {
+        private = (private_t*)pthread_getspecific(pthread_counter_key);
+        private->calls++;
+    }
+    printf("pthread_getspecific: %.2f ns/access\n", elapsed_nsec(&start) / ITERATIONS);
+}
+
+void bench_tls(void)
+{
+    struct timespec start;
+    private_t *private;
+    int count, status;
+
+    private = (private_t*)calloc(1, sizeof(private_t));
+    if (private == NULL)
+        errno_abort("Allocate private");
+    status = tls_set(tls_counter_key, private);
+    if (status != 0)
+        err_abort(status, "Set tls");
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (count = 0; count < ITERATIONS; count++) {
+        private = (private_t*)tls_get(tls_counter_key);
+        private->calls++;
+    }
+    printf("tls_get:             %.2f ns/access\n", elapsed_nsec(&start) / ITERATIONS);
+}
+
+void bench_thread(void)
+{
+    struct timespec start;
+    int count;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (count = 0; count < ITERATIONS; count++)
+        __atomic_store_n(&thread_counter, thread_counter + 1, __ATOMIC_RELAXED);
+    printf("__thread:            %.2f ns/access\n", elapsed_nsec(&start) / ITERATIONS);
+}
+
+void *thread_routine(void *arg)
+{
+    private_t *private;
+    int status;
+
+    private = (private_t*)malloc(sizeof(private_t));
+    if (private == NULL)
+        errno_abort("Allocate private");
+
+    private->calls = (long)arg + 1;
+    status = tls_set(tls_counter_key, private);
+    if (status != 0)
+        err_abort(status, "Set tls");
+
+    pthread_barrier_wait(&started);
+    pthread_barrier_wait(&sampled);
+    return NULL;
+}
+
+void print_slot(pthread_t thread_id, void *value, void *arg)
+{
+    private_t *private = (private_t*)value;
+    long *total = (long*)arg;
+
+    *total += private->calls;
+    printf("thread %lu: %ld calls\n", (unsigned long)thread_id, private->calls);
+}
+
+int main()
+{
+    pthread_t threads[THREADS];
+    long total = 0;
+    int count, status;
+
+    status = pthread_key_create(&pthread_counter_key, private_destructor);
+    if (status != 0)
+        err_abort(status, "Create key");
+
+    status = tls_key_create(&tls_counter_key, private_destructor);
+    if (status != 0)
+        err_abort(status, "Create tls key");
+
+    bench_pthread();
+    bench_tls();
+    bench_thread();
+
+    pthread_barrier_init(&started, NULL, THREADS + 1);
+    pthread_barrier_init(&sampled, NULL, THREADS + 1);
+
+    for (count = 0; count < THREADS; count++) {
+        status = pthread_create(&threads[count], NULL, thread_routine, (void*)(long)count);
+        if (status != 0)
+            err_abort(status, "Create thread");
+    }
+
+    pthread_barrier_wait(&started);
+    status = tls_foreach(tls_counter_key, print_slot, &total);
+    if (status != 0)
+        err_abort(status, "Enumerate tls");
+    printf("%ld calls in all threads\n", total);
+    pthread_barrier_wait(&sampled);
+
+    for (count = 0; count < THREADS; count++) {
+        status = pthread_join(threads[count], NULL);
+        if (status != 0)
+            err_abort(status, "Join thread");
+    }
+
+    pthread_barrier_destroy(&started);
+    pthread_barrier_destroy(&sampled);
+    return 0;
+}
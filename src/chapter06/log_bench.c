@@ -0,0 +1,82 @@
+#include <pthread.h>
+#include <time.h>
+#include "log.h"
+#include "errors.h"
+
+#define MAX_THREADS 64
+
+int use_log, lines;
+
+void *thread_routine(void *arg)
+{
+    long id = (long)arg;
+    int count;
+
+    for (count = 0; count < lines; count++) {
+        if (use_log)
+            log_printf("thread %ld line %d: the quick brown fox jumps over the lazy dog\n",
+                id, count);
+        else
+            printf("thread %ld line %d: the quick brown fox jumps over the lazy dog\n",
+                id, count);
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[MAX_THREADS];
+    struct timespec start, end;
+    double seconds;
+    long count;
+    int nthreads = 4, policy = LOG_DROP, status;
+    size_t budget = 1024 * 1024;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s stdio|log|log-block [threads [lines [budget_kb]]] > file\n", argv[0]);
+        return 1;
+    }
+
+    use_log = strncmp(argv[1], "log", 3) == 0;
+    if (strcmp(argv[1], "log-block") == 0)
+        policy = LOG_BLOCK;
+    if (argc > 2)
+        nthreads = atoi(argv[2]);
+    lines = (argc > 3) ? atoi(argv[3]) : 100000;
+    if (argc > 4)
+        budget = atol(argv[4]) * 1024;
+    if (nthreads < 1 || nthreads > MAX_THREADS)
+        nthreads = 4;
+
+    if (use_log) {
+        status = log_open(STDOUT_FILENO, budget, policy);
+        if (status != 0)
+            err_abort(status, "Open log");
+    } else
+        setvbuf(stdout, NULL, _IOLBF, BUFSIZ);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (count = 0; count < nthreads; count++) {
+        status = pthread_create(&threads[count], NULL, thread_routine, (void *)count);
+        if (status != 0)
+            err_abort(status, "Create thread");
+    }
+    for (count = 0; count < nthreads; count++) {
+        status = pthread_join(threads[count], NULL);
+        if (status != 0)
+            err_abort(status, "Join thread");
+    }
+
+    if (use_log) {
+        status = log_close();
+        if (status != 0)
+            err_abort(status, "Close log");
+    } else
+        fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%s: %d threads, %.0f lines/sec, %lu dropped\n", argv[1], nthreads,
+        (double)nthreads * lines / seconds, use_log ? log_dropped() : 0UL);
+    return 0;
+}
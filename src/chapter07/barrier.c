@@ -24,7 +24,7 @@ int barrier_destroy(barrier_t *barrier)
 {
     int status, status2;
 
-    if (barrier->valid == BARRIER_VALID)
+    if (barrier->valid != BARRIER_VALID)
         return EINVAL;
 
     status = pthread_mutex_lock(&barrier->mutex);
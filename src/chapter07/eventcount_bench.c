@@ -0,0 +1,256 @@
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "errors.h"
+#include "eventcount.h"
+#include "mpsc.h"
+
+#define PRODUCERS   2
+#define STREAM      200000
+#define TRICKLE     2000
+#define TRICKLE_USEC 50
+
+#define LOCKED      0
+#define FUTEX       1
+#define EVENTFD     2
+
+typedef struct item_tag {
+    struct item_tag     *link;
+    long                value;
+} item_t;
+
+typedef struct queue_tag {
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cv;
+    item_t              *first, *last;
+    int                 idle;
+    mpsc_t              inbox;
+    eventcount_t        ready;
+    int                 mode;
+    long                per_producer;
+    long                pause;
+    item_t              *items;
+} queue_t;
+
+queue_t queue = {.mutex = PTHREAD_MUTEX_INITIALIZER, .cv = PTHREAD_COND_INITIALIZER};
+
+const char *mode_names[] = {"mutex+cond", "mpsc+eventcount", "mpsc+eventcount/fd"};
+
+long now_nsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+long switches(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+/*
+ * The locked producer does what workq_add() does: take the mutex to
+ * queue the item and signal an idle consumer.
+ */
+void put(item_t *item)
+{
+    if (queue.mode != LOCKED) {
+        if (mpsc_push(&queue.inbox, item))
+            eventcount_notify(&queue.ready);
+        return;
+    }
+
+    item->link = NULL;
+    pthread_mutex_lock(&queue.mutex);
+    if (queue.first == NULL)
+        queue.first = item;
+    else
+        queue.last->link = item;
+    queue.last = item;
+    if (queue.idle > 0)
+        pthread_cond_signal(&queue.cv);
+    pthread_mutex_unlock(&queue.mutex);
+}
+
+item_t *take_all(void)
+{
+    item_t *list;
+    int key;
+
+    if (queue.mode == LOCKED) {
+        pthread_mutex_lock(&queue.mutex);
+        queue.idle++;
+        while (queue.first == NULL)
+            pthread_cond_wait(&queue.cv, &queue.mutex);
+        queue.idle--;
+        list = queue.first;
+        queue.first = queue.last = NULL;
+        pthread_mutex_unlock(&queue.mutex);
+        return list;
+    }
+
+    while ((list = (item_t *)mpsc_drain(&queue.inbox)) == NULL) {
+        key = eventcount_prepare(&queue.ready);
+        list = (item_t *)mpsc_drain(&queue.inbox);
+        if (list != NULL) {
+            eventcount_cancel(&queue.ready);
+            break;
+        }
+        eventcount_wait(&queue.ready, key, NULL);
+    }
+    return list;
+}
+
+void *producer_routine(void *arg)
+{
+    item_t *items = queue.items + (long)arg * queue.per_producer;
+    struct timespec pause = {0, queue.pause * 1000};
+    long count;
+
+    for (count = 0; count < queue.per_producer; count++) {
+        items[count].value = count;
+        put(&items[count]);
+        if (queue.pause)
+            nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+void run(int mode, long per_producer, long pause)
+{
+    pthread_t producers[PRODUCERS];
+    item_t *list;
+    long total = per_producer * PRODUCERS, received = 0, start, csw;
+    int count, status;
+
+    queue.mode = mode;
+    queue.per_producer = per_producer;
+    queue.pause = pause;
+    queue.first = queue.last = NULL;
+    queue.idle = 0;
+    mpsc_init(&queue.inbox, offsetof(item_t, link));
+    status = eventcount_init(&queue.ready, mode == EVENTFD ? EVENTCOUNT_EVENTFD : EVENTCOUNT_FUTEX);
+    if (status != 0)
+        err_abort(status, "Init eventcount");
+    queue.items = (item_t *)malloc(total * sizeof(item_t));
+    if (queue.items == NULL)
+        errno_abort("Allocate items");
+
+    csw = switches();
+    start = now_nsec();
+    for (count = 0; count < PRODUCERS; count++) {
+        status = pthread_create(&producers[count], NULL, producer_routine, (void *)(long)count);
+        if (status != 0)
+            err_abort(status, "Create producer");
+    }
+    while (received < total)
+        for (list = take_all(); list != NULL; list = list->link)
+            received++;
+    for (count = 0; count < PRODUCERS; count++)
+        pthread_join(producers[count], NULL);
+
+    printf("%-20s %-8s %12.0f items/s %10.3f switches/item\n", mode_names[mode],
+        pause ? "trickle" : "stream", total / ((now_nsec() - start) / 1e9),
+        (double)(switches() - csw) / total);
+
+    eventcount_destroy(&queue.ready);
+    free(queue.items);
+}
+
+/*
+ * One consumer waits in epoll on both a pipe and the queue's
+ * eventcount; a producer alternates between the two.
+ */
+void *mixed_routine(void *arg)
+{
+    int fd = *(int *)arg;
+    long count;
+
+    for (count = 0; count < TRICKLE; count++) {
+        if (count % 2 == 0)
+            put(&queue.items[count]);
+        else if (write(fd, "x", 1) != 1)
+            errno_abort("Write pipe");
+    }
+    return NULL;
+}
+
+void run_epoll(void)
+{
+    struct epoll_event event, events[2];
+    pthread_t producer;
+    item_t *list;
+    char buffer[256];
+    long messages = 0, bytes = 0;
+    int pipes[2], epfd, ready, count, status;
+    ssize_t size;
+
+    queue.mode = EVENTFD;
+    mpsc_init(&queue.inbox, offsetof(item_t, link));
+    status = eventcount_init(&queue.ready, EVENTCOUNT_EVENTFD);
+    if (status != 0)
+        err_abort(status, "Init eventcount");
+    queue.items = (item_t *)malloc(TRICKLE * sizeof(item_t));
+    if (queue.items == NULL)
+        errno_abort("Allocate items");
+
+    if (pipe(pipes) != 0)
+        errno_abort("Create pipe");
+    epfd = epoll_create1(0);
+    if (epfd < 0)
+        errno_abort("Create epoll");
+    event.events = EPOLLIN;
+    event.data.fd = pipes[0];
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, pipes[0], &event) != 0)
+        errno_abort("Add pipe");
+    event.data.fd = eventcount_fd(&queue.ready);
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, event.data.fd, &event) != 0)
+        errno_abort("Add eventcount");
+
+    status = pthread_create(&producer, NULL, mixed_routine, &pipes[1]);
+    if (status != 0)
+        err_abort(status, "Create producer");
+
+    while (messages < TRICKLE / 2 || bytes < TRICKLE / 2) {
+        eventcount_prepare(&queue.ready);
+        list = (item_t *)mpsc_drain(&queue.inbox);
+        if (list == NULL) {
+            ready = epoll_wait(epfd, events, 2, -1);
+            for (count = 0; count < ready; count++) {
+                if (events[count].data.fd == pipes[0]
+                    && (size = read(pipes[0], buffer, sizeof(buffer))) > 0)
+                    bytes += size;
+            }
+            list = (item_t *)mpsc_drain(&queue.inbox);
+        }
+        eventcount_cancel(&queue.ready);
+        for (; list != NULL; list = list->link)
+            messages++;
+    }
+
+    pthread_join(producer, NULL);
+    printf("epoll: %ld queue items and %ld pipe bytes from one wait loop\n", messages, bytes);
+
+    close(epfd);
+    close(pipes[0]);
+    close(pipes[1]);
+    eventcount_destroy(&queue.ready);
+    free(queue.items);
+}
+
+int main(int argc, char *argv[])
+{
+    int mode;
+
+    for (mode = LOCKED; mode <= EVENTFD; mode++)
+        run(mode, STREAM, 0);
+    for (mode = LOCKED; mode <= EVENTFD; mode++)
+        run(mode, TRICKLE, TRICKLE_USEC);
+    run_epoll();
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "perthread.h"
+#include "errors.h"
+
+#define MAX_THREADS 16
+#define UPDATES     50000000
+
+typedef struct counter_tag {
+    unsigned long   value;
+} counter_t;
+
+typedef struct worker_tag {
+    pthread_t       thread_id;
+    counter_t       *counter;
+} worker_t;
+
+pthread_barrier_t barrier;
+
+static inline uint64_t cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+void *worker_routine(void *arg)
+{
+    worker_t *self = (worker_t *)arg;
+    volatile unsigned long *value = &self->counter->value;
+    long count;
+
+    pthread_barrier_wait(&barrier);
+    for (count = 0; count < UPDATES; count++)
+        (*value)++;
+    return NULL;
+}
+
+/*
+ * Runs one incrementing thread per counter and returns the elapsed
+ * cycles (nanoseconds where no cycle counter is available) divided by
+ * the updates each thread made.
+ */
+double run(counter_t **counters, int threads)
+{
+    worker_t workers[MAX_THREADS];
+    uint64_t start;
+    int count, status;
+
+    status = pthread_barrier_init(&barrier, NULL, threads + 1);
+    if (status != 0)
+        err_abort(status, "Init barrier");
+
+    for (count = 0; count < threads; count++) {
+        workers[count].counter = counters[count];
+        status = pthread_create(&workers[count].thread_id, NULL, worker_routine, &workers[count]);
+        if (status != 0)
+            err_abort(status, "Create worker");
+    }
+
+    pthread_barrier_wait(&barrier);
+    start = cycles();
+    for (count = 0; count < threads; count++) {
+        status = pthread_join(workers[count].thread_id, NULL);
+        if (status != 0)
+            err_abort(status, "Join worker");
+    }
+
+    pthread_barrier_destroy(&barrier);
+    return (double)(cycles() - start) / UPDATES;
+}
+
+int main(int argc, char *argv[])
+{
+    counter_t packed[MAX_THREADS] __attribute__((aligned(64)));
+    counter_t *counters[MAX_THREADS];
+    perthread_t padded;
+    int threads = 4, count, status;
+
+    if (argc > 1)
+        threads = atoi(argv[1]);
+    if (threads < 1 || threads > MAX_THREADS)
+        threads = 4;
+
+    status = perthread_init(&padded, threads, sizeof(counter_t));
+    if (status != 0)
+        err_abort(status, "Allocate counters");
+
+    printf("cache line %zu bytes, %d threads\n", cacheline_size(), threads);
+
+    for (count = 0; count < threads; count++)
+        counters[count] = &packed[count];
+    printf("packed: %6.2f cycles/update\n", run(counters, threads));
+
+    for (count = 0; count < threads; count++)
+        counters[count] = PERTHREAD(&padded, counter_t, count);
+    printf("padded: %6.2f cycles/update\n", run(counters, threads));
+
+    perthread_destroy(&padded);
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include <pthread.h>
+#include <math.h>
+#include <time.h>
+#include "parfor.h"
+#include "errors.h"
+
+#define MAX_THREADS 8
+#define ELEMENTS    (1 << 14)
+#define ROUNDS      20
+#define GRAIN       64
+
+typedef struct crew_tag {
+    pthread_t   thread_id;
+    int         number;
+    int         threads;
+} crew_t;
+
+double values[ELEMENTS];
+pthread_barrier_t barrier;
+
+uint64_t now_nsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/*
+ * Per-element cost grows with the index, so an even static split
+ * leaves the first threads idle while the last one finishes.
+ */
+double element(long index)
+{
+    double value = index;
+    long step, steps = 1 + (index * index) / ((long)ELEMENTS * ELEMENTS / 512);
+
+    for (step = 0; step < steps; step++)
+        value = sqrt(value + step);
+    return value;
+}
+
+void compute(long first, long last, void *arg)
+{
+    long index;
+
+    for (index = first; index < last; index++)
+        values[index] = element(index);
+}
+
+double sum(long first, long last, void *arg)
+{
+    double total = 0;
+    long index;
+
+    for (index = first; index < last; index++)
+        total += element(index);
+    return total;
+}
+
+double add(double a, double b)
+{
+    return a + b;
+}
+
+void *crew_routine(void *arg)
+{
+    crew_t *self = (crew_t *)arg;
+    long block = ELEMENTS / self->threads;
+    int round, status;
+
+    for (round = 0; round < ROUNDS; round++) {
+        status = pthread_barrier_wait(&barrier);
+        if (status > 0)
+            err_abort(status, "Wait on barrier");
+
+        compute(block * self->number, self->number == self->threads - 1
+            ? ELEMENTS : block * (self->number + 1), NULL);
+
+        status = pthread_barrier_wait(&barrier);
+        if (status > 0)
+            err_abort(status, "Wait on barrier");
+    }
+    return NULL;
+}
+
+double bench_barrier(int threads)
+{
+    crew_t crew[MAX_THREADS];
+    uint64_t start;
+    int count, status;
+
+    status = pthread_barrier_init(&barrier, NULL, threads);
+    if (status != 0)
+        err_abort(status, "Init barrier");
+
+    start = now_nsec();
+    for (count = 0; count < threads; count++) {
+        crew[count].number = count;
+        crew[count].threads = threads;
+        status = pthread_create(&crew[count].thread_id, NULL, crew_routine, &crew[count]);
+        if (status != 0)
+            err_abort(status, "Create crew");
+    }
+    for (count = 0; count < threads; count++) {
+        status = pthread_join(crew[count].thread_id, NULL);
+        if (status != 0)
+            err_abort(status, "Join crew");
+    }
+
+    pthread_barrier_destroy(&barrier);
+    return (now_nsec() - start) / 1e6 / ROUNDS;
+}
+
+double bench_parfor(team_t *team, int schedule)
+{
+    uint64_t start;
+    int round, status;
+
+    start = now_nsec();
+    for (round = 0; round < ROUNDS; round++) {
+        status = parallel_for(team, 0, ELEMENTS, GRAIN, schedule, compute, NULL);
+        if (status != 0)
+            err_abort(status, "Parallel for");
+    }
+    return (now_nsec() - start) / 1e6 / ROUNDS;
+}
+
+int main(int argc, char *argv[])
+{
+    team_t team;
+    double serial, total;
+    int threads, status;
+
+    printf("%7s %10s %10s %10s %10s   (ms/round)\n", "threads", "barrier", "static",
+        "dynamic", "guided");
+    for (threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        status = team_init(&team, threads - 1);
+        if (status != 0)
+            err_abort(status, "Init team");
+
+        printf("%7d %10.2f %10.2f %10.2f %10.2f\n", threads, bench_barrier(threads),
+            bench_parfor(&team, PARFOR_STATIC), bench_parfor(&team, PARFOR_DYNAMIC),
+            bench_parfor(&team, PARFOR_GUIDED));
+
+        if (threads == MAX_THREADS) {
+            serial = sum(0, ELEMENTS, NULL);
+            status = parallel_reduce(&team, 0, ELEMENTS, GRAIN, PARFOR_GUIDED, sum, add, 0,
+                NULL, &total);
+            if (status != 0)
+                err_abort(status, "Parallel reduce");
+            printf("parallel_reduce %.6f, serial %.6f\n", total, serial);
+        }
+
+        status = team_destroy(&team);
+        if (status != 0)
+            err_abort(status, "Destroy team");
+    }
+    return 0;
+}
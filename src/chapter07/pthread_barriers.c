@@ -1,4 +1,5 @@
 #include <pthread.h>
+#include "perthread.h"
 #include "errors.h"
 
 #define THREADS 5
@@ -14,7 +15,7 @@ typedef struct thread_tag {
 } thread_t;
 
 pthread_barrier_t barrier;
-thread_t threads[THREADS];
+perthread_t threads;
 
 void *thread_routine(void *arg)
 {
@@ -38,7 +39,7 @@ void *thread_routine(void *arg)
             int thread_num;
 
             for (thread_num = 0; thread_num < THREADS; thread_num++)
-                threads[thread_num].increment += 1;
+                PERTHREAD(&threads, thread_t, thread_num)->increment += 1;
         }
     }
 
@@ -47,36 +48,44 @@ void *thread_routine(void *arg)
 
 int main()
 {
+    thread_t *thread;
     int thread_count, array_count;
     int status;
     
     pthread_barrier_init(&barrier, NULL, THREADS);
 
+    status = perthread_init(&threads, THREADS, sizeof(thread_t));
+    if (status != 0)
+        err_abort(status, "Allocate threads");
+
     for (thread_count = 0; thread_count < THREADS; thread_count++) {
-        threads[thread_count].increment = thread_count;
-        threads[thread_count].number = thread_count;
+        thread = PERTHREAD(&threads, thread_t, thread_count);
+        thread->increment = thread_count;
+        thread->number = thread_count;
 
         for (array_count = 0; array_count < ARRAY; array_count++)
-            threads[thread_count].array[array_count] = array_count + 1;
+            thread->array[array_count] = array_count + 1;
 
-        status = pthread_create(&threads[thread_count].thread_id, NULL, thread_routine, (void*)&threads[thread_count]);
+        status = pthread_create(&thread->thread_id, NULL, thread_routine, (void*)thread);
         if (status != 0)
             err_abort(status, "Create threads");
     }
 
     for (thread_count = 0; thread_count < THREADS; thread_count++) {
-        status = pthread_join(threads[thread_count].thread_id, NULL);
+        thread = PERTHREAD(&threads, thread_t, thread_count);
+        status = pthread_join(thread->thread_id, NULL);
         if (status != 0)
             err_abort(status, "Join threads");
 
-        printf("%02d: (%d)", thread_count, threads[thread_count].increment);
+        printf("%02d: (%d)", thread_count, thread->increment);
 
         for (array_count = 0; array_count < ARRAY; array_count++)
-            printf("%010u ", threads[thread_count].array[array_count]);
+            printf("%010u ", thread->array[array_count]);
 
         printf("\n"); 
     }
 
+    perthread_destroy(&threads);
     pthread_barrier_destroy(&barrier);
     return 0;
 }
\ No newline at end of file
@@ -1,3 +1,4 @@
+#define RWLOCK_IMPL
 #include "errors.h"
 #include "rwlock.h"
 
@@ -29,4 +29,51 @@ int rwl_writelock(rwlock_t *rwlock);
 int rwl_writetrylock(rwlock_t *rwlock);
 int rwl_writeunlock(rwlock_t *rwlock);
 
+#if defined(LOCKDEP) && !defined(RWLOCK_IMPL)
+#include "lockdep.h"
+
+static inline int lockdep_rwl_lock(rwlock_t *rwl, int (*lock)(rwlock_t *),
+    const char *file, int line)
+{
+    int status;
+
+    lockdep_acquire(rwl, 0, file, line);
+    status = lock(rwl);
+    if (status != 0)
+        lockdep_release(rwl);
+    return status;
+}
+
+static inline int lockdep_rwl_trylock(rwlock_t *rwl, int (*trylock)(rwlock_t *),
+    const char *file, int line)
+{
+    int status;
+
+    status = trylock(rwl);
+    if (status == 0)
+        lockdep_acquire(rwl, 1, file, line);
+    return status;
+}
+
+static inline int lockdep_rwl_unlock(rwlock_t *rwl, int (*unlock)(rwlock_t *))
+{
+    lockdep_release(rwl);
+    return unlock(rwl);
+}
+
+static inline int lockdep_rwl_destroy(rwlock_t *rwl)
+{
+    lockdep_forget(rwl);
+    return rwl_destroy(rwl);
+}
+
+#define rwl_destroy(rwl)        lockdep_rwl_destroy(rwl)
+#define rwl_readlock(rwl)       lockdep_rwl_lock(rwl, rwl_readlock, __FILE__, __LINE__)
+#define rwl_readtrylock(rwl)    lockdep_rwl_trylock(rwl, rwl_readtrylock, __FILE__, __LINE__)
+#define rwl_readunlock(rwl)     lockdep_rwl_unlock(rwl, rwl_readunlock)
+#define rwl_writelock(rwl)      lockdep_rwl_lock(rwl, rwl_writelock, __FILE__, __LINE__)
+#define rwl_writetrylock(rwl)   lockdep_rwl_trylock(rwl, rwl_writetrylock, __FILE__, __LINE__)
+#define rwl_writeunlock(rwl)    lockdep_rwl_unlock(rwl, rwl_writeunlock)
+#endif
+
 #endif
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "rwlock.h"
+#include "perthread.h"
 #include "errors.h"
 
 #define THREADS     5
@@ -19,40 +20,42 @@ typedef struct data_tag {
     int         updates;
 } data_t;
 
-thread_t threads[THREADS];
-data_t  data[DATASIZE];
+perthread_t threads;
+perthread_t data;
 
 void *thread_routine(void *arg)
 {
     thread_t *self = (thread_t*)arg;
+    data_t *item;
     int repeats = 0;
     int iteration;
     int element = 0;
     int status;
 
     for (iteration = 0; iteration < ITERATIONS; iteration++) {
+        item = PERTHREAD(&data, data_t, element);
         if (iteration % self->interval == 0) {
-            status = rwl_writelock(&data[element].lock);
+            status = rwl_writelock(&item->lock);
             if (status != 0)
                 err_abort(status, "Write lock");
 
-            data[element].data = self->thread_num;
-            data[element].updates++;
+            item->data = self->thread_num;
+            item->updates++;
             self->updates++;
 
-            status = rwl_writeunlock(&data[element].lock);
+            status = rwl_writeunlock(&item->lock);
             if (status != 0)
                 err_abort(status, "Write unlock");
         } else {
-            status = rwl_readlock(&data[element].lock);
+            status = rwl_readlock(&item->lock);
             if (status != 0)
                 err_abort(status, "Read lock");
 
             self->reads++;
-            if (data[element].data == self->thread_num)
+            if (item->data == self->thread_num)
                 repeats++;
 
-            status = rwl_readunlock(&data[element].lock);
+            status = rwl_readunlock(&item->lock);
             if (status != 0)
                 err_abort(status, "Read unlock");
         }
@@ -70,6 +73,8 @@ void *thread_routine(void *arg)
 
 int main()
 {
+    thread_t *thread;
+    data_t *item;
     int count;
     int data_count;
     int status;
@@ -77,44 +82,58 @@ int main()
     int thread_updates = 0;
     int data_updates = 0;
 
+    status = perthread_init(&threads, THREADS, sizeof(thread_t));
+    if (status != 0)
+        err_abort(status, "Allocate threads");
+    status = perthread_init(&data, DATASIZE, sizeof(data_t));
+    if (status != 0)
+        err_abort(status, "Allocate data");
+
     for (data_count = 0; data_count < DATASIZE; data_count++) {
-        data[data_count].data = 0;
-        data[data_count].updates = 0;
-        status = rwl_init(&data[data_count].lock);
+        item = PERTHREAD(&data, data_t, data_count);
+        item->data = 0;
+        item->updates = 0;
+        status = rwl_init(&item->lock);
         if (status != 0)
             err_abort(status, "Init rw lock");
     }
 
     for (count = 0; count < THREADS; count++) {
-        threads[count].thread_num = count;
-        threads[count].updates = 0;
-        threads[count].reads = 0;
-        threads[count].interval = rand_r(&seed) % 7;
-        status = pthread_create(&threads[count].thread_id, 
-            NULL, thread_routine, (void *)&threads[count]);
+        thread = PERTHREAD(&threads, thread_t, count);
+        thread->thread_num = count;
+        thread->updates = 0;
+        thread->reads = 0;
+        thread->interval = rand_r(&seed) % 7;
+        status = pthread_create(&thread->thread_id, 
+            NULL, thread_routine, (void *)thread);
         if (status != 0)
             err_abort(status, "Create thread");
     }
 
     for (count = 0; count < THREADS; count++) {
-        status = pthread_join(threads[count].thread_id, NULL);
+        thread = PERTHREAD(&threads, thread_t, count);
+        status = pthread_join(thread->thread_id, NULL);
         if (status != 0)
             err_abort(status, "Join thread");
 
-        thread_updates += threads[count].updates;
+        thread_updates += thread->updates;
         printf("%02d: interval %d, updated %d, reads %d\n",
-            count, threads[count].interval,
-            threads[count].updates, threads[count].reads);
+            count, thread->interval,
+            thread->updates, thread->reads);
     }
 
     for (data_count = 0; data_count < DATASIZE; data_count++) {
-        data_updates += data[data_count].updates;
+        item = PERTHREAD(&data, data_t, data_count);
+        data_updates += item->updates;
         printf("data %02d: value %d, %d updates\n",
-            data_count, data[data_count].data,
-            data[data_count].updates);
-        rwl_destroy(&data[data_count].lock);
+            data_count, item->data,
+            item->updates);
+        rwl_destroy(&item->lock);
     }
 
+    perthread_destroy(&data);
+    perthread_destroy(&threads);
+
     printf("%d thread updates, %d data updates\n", thread_updates, data_updates);
     return 0;
 }
\ No newline at end of file
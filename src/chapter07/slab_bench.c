@@ -0,0 +1,132 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "slab.h"
+#include "mpsc.h"
+#include "errors.h"
+
+#define PRODUCERS   3
+#define ITEMS       500000
+
+typedef struct item_tag {
+    struct item_tag *link;
+    int             value;
+    int             power;
+} item_t;
+
+slab_t slab;
+mpsc_t inbox = MPSC_INITIALIZER(item_t, link);
+int use_slab = 1;
+int producers_left = PRODUCERS;
+
+item_t *item_alloc(void)
+{
+    return use_slab ? (item_t*)slab_alloc(&slab) : (item_t*)malloc(sizeof(item_t));
+}
+
+void item_free(item_t *item)
+{
+    if (use_slab)
+        slab_free(&slab, item);
+    else
+        free(item);
+}
+
+void *producer_routine(void *arg)
+{
+    item_t *item;
+    int count;
+
+    for (count = 0; count < ITEMS; count++) {
+        item = item_alloc();
+        if (item == NULL)
+            errno_abort("Allocate item");
+        if (((uintptr_t)item & (SLAB_ALIGN - 1)) != 0)
+            err_abort(EFAULT, "Misaligned item");
+
+        item->value = count;
+        item->power = 2;
+        mpsc_push(&inbox, item);
+
+        if ((count & 1023) == 0)
+            sched_yield();
+    }
+
+    __sync_fetch_and_sub(&producers_left, 1);
+    return NULL;
+}
+
+void *consumer_routine(void *arg)
+{
+    item_t *item, *next;
+    long consumed = 0;
+
+    while (1) {
+        item = (item_t*)mpsc_drain(&inbox);
+        if (item == NULL) {
+            if (__sync_fetch_and_add(&producers_left, 0) == 0 && mpsc_empty(&inbox))
+                break;
+            sched_yield();
+            continue;
+        }
+
+        for (; item != NULL; item = next) {
+            next = item->link;
+            consumed++;
+            item_free(item);
+        }
+    }
+
+    if (use_slab)
+        slab_flush(&slab);
+    return (void*)consumed;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t producers[PRODUCERS], consumer;
+    struct timespec start, end;
+    void *consumed;
+    double seconds;
+    int count, status;
+
+    if (argc > 1)
+        use_slab = strcmp(argv[1], "malloc") != 0;
+
+    status = slab_init(&slab, sizeof(item_t));
+    if (status != 0)
+        err_abort(status, "Init slab");
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    status = pthread_create(&consumer, NULL, consumer_routine, NULL);
+    if (status != 0)
+        err_abort(status, "Create consumer");
+
+    for (count = 0; count < PRODUCERS; count++) {
+        status = pthread_create(&producers[count], NULL, producer_routine, NULL);
+        if (status != 0)
+            err_abort(status, "Create producer");
+    }
+
+    for (count = 0; count < PRODUCERS; count++) {
+        status = pthread_join(producers[count], NULL);
+        if (status != 0)
+            err_abort(status, "Join producer");
+    }
+
+    status = pthread_join(consumer, &consumed);
+    if (status != 0)
+        err_abort(status, "Join consumer");
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("%s: %ld items, %.0f alloc/free pairs per second\n",
+        use_slab ? "slab" : "malloc", (long)consumed, (long)consumed / seconds);
+
+    status = slab_destroy(&slab);
+    if (status != 0)
+        err_abort(status, "Destroy slab");
+    return 0;
+}
@@ -30,4 +30,39 @@ static inline void spinlock_destroy(spinlock_t *sl)
     (void) sl;
 }
 
+#if defined(LOCKDEP) && !defined(SPINLOCK_IMPL)
+#include "lockdep.h"
+
+static inline void lockdep_spinlock_lock(spinlock_t *sl, const char *file, int line)
+{
+    lockdep_acquire(sl, 0, file, line);
+    spinlock_lock(sl);
+}
+
+static inline int lockdep_spinlock_trylock(spinlock_t *sl, const char *file, int line)
+{
+    if (!spinlock_trylock(sl))
+        return 0;
+    lockdep_acquire(sl, 1, file, line);
+    return 1;
+}
+
+static inline void lockdep_spinlock_unlock(spinlock_t *sl)
+{
+    lockdep_release(sl);
+    spinlock_unlock(sl);
+}
+
+static inline void lockdep_spinlock_destroy(spinlock_t *sl)
+{
+    lockdep_forget(sl);
+    spinlock_destroy(sl);
+}
+
+#define spinlock_lock(sl)       lockdep_spinlock_lock(sl, __FILE__, __LINE__)
+#define spinlock_trylock(sl)    lockdep_spinlock_trylock(sl, __FILE__, __LINE__)
+#define spinlock_unlock(sl)     lockdep_spinlock_unlock(sl)
+#define spinlock_destroy(sl)    lockdep_spinlock_destroy(sl)
+#endif
+
 #endif //SPINLOCK_H
\ No newline at end of file
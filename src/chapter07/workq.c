@@ -2,6 +2,51 @@
 #include "workq.h"
 #include "errors.h"
 
+static void *workq_server(void *arg);
+
+static void workq_fork_prepare(void *arg)
+{
+    workq_t *wq = (workq_t *)arg;
+    int status;
+
+    status = pthread_mutex_lock(&wq->mutex);
+    if (status != 0)
+        err_abort(status, "Lock work queue in prepare handler");
+}
+
+static void workq_fork_parent(void *arg)
+{
+    workq_t *wq = (workq_t *)arg;
+    int status;
+
+    status = pthread_mutex_unlock(&wq->mutex);
+    if (status != 0)
+        err_abort(status, "Unlock work queue in parent handler");
+}
+
+static void workq_fork_child(void *arg)
+{
+    workq_t *wq = (workq_t *)arg;
+    pthread_t id;
+    int status;
+
+    wq->counter = 0;
+    wq->idle = 0;
+    status = pthread_cond_init(&wq->cv, NULL);
+    if (status != 0)
+        err_abort(status, "Reinit work queue condition in child handler");
+
+    if (wq->first != NULL) {
+        status = pthread_create(&id, &wq->attr, workq_server, (void*)wq);
+        if (status == 0)
+            wq->counter++;
+    }
+
+    status = pthread_mutex_unlock(&wq->mutex);
+    if (status != 0)
+        err_abort(status, "Unlock work queue in child handler");
+}
+
 int workq_init(workq_t *wq, int threads, void (*engine)(void *arg))
 {
     int status;
@@ -35,6 +80,16 @@ int workq_init(workq_t *wq, int threads, void (*engine)(void *arg))
     wq->counter = 0;
     wq->idle = 0;
     wq->engine = engine;
+
+    status = forksafe_register(&wq->fork, FORKSAFE_RANK_WORKQ,
+        workq_fork_prepare, workq_fork_parent, workq_fork_child, (void*)wq);
+    if (status != 0) {
+        pthread_cond_destroy(&wq->cv);
+        pthread_mutex_destroy(&wq->mutex);
+        pthread_attr_destroy(&wq->attr);
+        return status;
+    }
+
     wq->valid = WORKQ_VALID;
 
     return 0;
@@ -76,6 +131,10 @@ int workq_destroy(workq_t *wq)
     if (status != 0)
         return status;
 
+    status = forksafe_unregister(&wq->fork);
+    if (status != 0)
+        return status;
+
     status = pthread_mutex_destroy(&wq->mutex);
     status1 = pthread_cond_destroy(&wq->cv);
     status2 = pthread_attr_destroy(&wq->attr);
@@ -89,32 +148,35 @@ static void *workq_server(void *arg)
     workq_ele_t *we;
     int status, timedout;
 
-    printf("A worker is starting\n");
+    DPRINTF(("A worker is starting\n"));
     status = pthread_mutex_lock(&wq->mutex);
     if (status != 0)
         return NULL;
 
     while (1) {
         timedout = 0;
-        printf("Worker waiting for work\n");
+        DPRINTF(("Worker waiting for work\n"));
         clock_gettime(CLOCK_REALTIME, &timeout);
         timeout.tv_sec += 2;
 
+        wq->idle++;
         while (wq->first == NULL && !wq->quit) {
             status = pthread_cond_timedwait(&wq->cv, &wq->mutex, &timeout);
             if (status == ETIMEDOUT) {
-                printf("Worker wait timed out\n");
+                DPRINTF(("Worker wait timed out\n"));
                 timedout = 1;
                 break;
             } else if (status != 0) {
-                printf("Worker wait failed, %d (%s)\n", status, strerror(status));
+                DPRINTF(("Worker wait failed, %d (%s)\n", status, strerror(status)));
+                wq->idle--;
                 wq->counter--;
                 pthread_mutex_unlock(&wq->mutex);
                 return NULL;
             }
         }
+        wq->idle--;
 
-        printf("Work queue: 0x%p, quit: %d\n", wq->first, wq->quit);
+        DPRINTF(("Work queue: 0x%p, quit: %d\n", wq->first, wq->quit));
         we = wq->first;
 
         if (we != NULL) {
@@ -126,7 +188,7 @@ static void *workq_server(void *arg)
             if (status != 0)
                 return NULL;
 
-            printf("Worker calling engine\n");
+            DPRINTF(("Worker calling engine\n"));
             wq->engine(we->data);
             free(we);
 
@@ -136,7 +198,7 @@ static void *workq_server(void *arg)
         }
 
         if (wq->first == NULL && wq->quit) {
-            printf("Worker shutting down\n");
+            DPRINTF(("Worker shutting down\n"));
             wq->counter--;
 
             if (wq->counter == 0)
@@ -147,14 +209,14 @@ static void *workq_server(void *arg)
         }
 
         if (wq->first == NULL && timedout) {
-            printf("engine terminating due to timeout.\n");
+            DPRINTF(("engine terminating due to timeout.\n"));
             wq->counter--;
             break;
         }
     }
 
     pthread_mutex_unlock(&wq->mutex);
-    printf("worker exiting\n");
+    DPRINTF(("worker exiting\n"));
     return NULL;
 }
 
@@ -193,7 +255,7 @@ int workq_add(workq_t *wq, void *element)
             return status;
         }
     } else if(wq->counter < wq->parallelism) {
-        printf("Creating new worker\n");
+        DPRINTF(("Creating new worker\n"));
         status = pthread_create(&id, &wq->attr, workq_server, (void*)wq);
         if (status != 0) {
             pthread_mutex_unlock(&wq->mutex);
@@ -2,6 +2,7 @@
 #define WORKQ_H
 
 #include <pthread.h>
+#include "forksafe.h"
 
 typedef struct workq_ele_tag {
     struct workq_ele_tag    *next;
@@ -19,6 +20,7 @@ typedef struct workq_tag {
     int                 counter;
     int                 idle;
     void                (*engine)(void *);
+    forksafe_t          fork;
 } workq_t;
 
 #define WORKQ_VALID 0xdec2018
@@ -0,0 +1,140 @@
+#include <sys/wait.h>
+#include <time.h>
+#include "workq.h"
+#include "forksafe.h"
+#include "errors.h"
+
+#define WORKERS     4
+#define ITEMS       40
+#define FORKS       10
+#define CHILD_ITEMS 4
+
+pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t trace_cv = PTHREAD_COND_INITIALIZER;
+forksafe_t trace_fork;
+int completed = 0;
+workq_t workq;
+
+void trace_prepare(void *arg)
+{
+    int status;
+
+    status = pthread_mutex_lock(&trace_mutex);
+    if (status != 0)
+        err_abort(status, "Lock trace in prepare handler");
+    fflush(stdout);
+}
+
+void trace_parent(void *arg)
+{
+    int status;
+
+    status = pthread_mutex_unlock(&trace_mutex);
+    if (status != 0)
+        err_abort(status, "Unlock trace in parent handler");
+}
+
+void trace_child(void *arg)
+{
+    int status;
+
+    completed = 0;
+    status = pthread_cond_init(&trace_cv, NULL);
+    if (status != 0)
+        err_abort(status, "Reinit trace condition");
+
+    status = pthread_mutex_unlock(&trace_mutex);
+    if (status != 0)
+        err_abort(status, "Unlock trace in child handler");
+}
+
+void engine_routine(void *arg)
+{
+    struct timespec delay = {0, 1000000};
+    int status;
+
+    nanosleep(&delay, NULL);
+
+    status = pthread_mutex_lock(&trace_mutex);
+    if (status != 0)
+        err_abort(status, "Lock trace");
+    completed++;
+    status = pthread_cond_broadcast(&trace_cv);
+    if (status != 0)
+        err_abort(status, "Signal trace");
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+int run_child(void)
+{
+    struct timespec timeout;
+    int count, status;
+
+    for (count = 0; count < CHILD_ITEMS; count++) {
+        status = workq_add(&workq, NULL);
+        if (status != 0)
+            return 1;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += 5;
+
+    pthread_mutex_lock(&trace_mutex);
+    while (completed < CHILD_ITEMS) {
+        status = pthread_cond_timedwait(&trace_cv, &trace_mutex, &timeout);
+        if (status == ETIMEDOUT)
+            break;
+    }
+    count = completed;
+    pthread_mutex_unlock(&trace_mutex);
+
+    return count < CHILD_ITEMS;
+}
+
+int main(int argc, char *argv[])
+{
+    struct timespec start, end;
+    double fork_usec = 0;
+    pid_t pid;
+    int count, status, child_status, failed = 0;
+
+    status = forksafe_register(&trace_fork, FORKSAFE_RANK_LOG,
+        trace_prepare, trace_parent, trace_child, NULL);
+    if (status != 0)
+        err_abort(status, "Register trace");
+
+    status = workq_init(&workq, WORKERS, engine_routine);
+    if (status != 0)
+        err_abort(status, "Init work queue");
+
+    for (count = 0; count < ITEMS; count++) {
+        status = workq_add(&workq, NULL);
+        if (status != 0)
+            err_abort(status, "Add to work queue");
+
+        if (count % (ITEMS / FORKS) != 0)
+            continue;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        pid = fork();
+        if (pid == (pid_t)-1)
+            errno_abort("Fork");
+        if (pid == 0)
+            _exit(run_child());
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        fork_usec += (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+
+        if (waitpid(pid, &child_status, 0) == (pid_t)-1)
+            errno_abort("Wait for child");
+        if (!WIFEXITED(child_status) || WEXITSTATUS(child_status) != 0)
+            failed++;
+    }
+
+    status = workq_destroy(&workq);
+    if (status != 0)
+        err_abort(status, "Destroy work queue");
+
+    printf("%d forks, %d children failed, %.1f us/fork\n", FORKS, failed, fork_usec / FORKS);
+    return failed != 0;
+}
@@ -0,0 +1,350 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <time.h>
+#include "errors.h"
+#include "bench.h"
+
+typedef struct bench_thread_tag {
+    pthread_t           thread_id;
+    bench_case_t        *test;
+    bench_config_t      *config;
+    pthread_barrier_t   *barrier;
+    int                 index;
+    double              *samples;
+    long                nsamples;
+    uint64_t            start, end;
+} bench_thread_t;
+
+static uint64_t bench_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static int bench_compare(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double bench_percentile(double *values, long count, double percentile)
+{
+    if (count == 0)
+        return 0;
+    qsort(values, count, sizeof(double), bench_compare);
+    return values[(long)(percentile * (count - 1) + 0.5)];
+}
+
+void bench_config_init(bench_config_t *config)
+{
+    config->warmup = 1;
+    config->repeats = 5;
+    config->min_threads = 1;
+    config->max_threads = 4;
+    config->pin = 0;
+    config->ops = 100000;
+    config->sample = 1000;
+    config->format = BENCH_TEXT;
+    config->tolerance = 0.10;
+    config->filter = NULL;
+    config->baseline = NULL;
+    config->save = NULL;
+}
+
+static void bench_usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [--threads N|MIN-MAX] [--ops N] [--sample N] [--warmup N]\n"
+        "    [--repeats N] [--pin] [--format text|csv|json] [--filter NAME]\n"
+        "    [--save FILE] [--baseline FILE] [--tolerance PERCENT]\n", program);
+}
+
+int bench_parse_args(bench_config_t *config, int argc, char *argv[])
+{
+    char *option, *value;
+    int count;
+
+    for (count = 1; count < argc; count++) {
+        option = argv[count];
+        if (strcmp(option, "--pin") == 0) {
+            config->pin = 1;
+            continue;
+        }
+        if (count + 1 >= argc) {
+            bench_usage(argv[0]);
+            return EINVAL;
+        }
+        value = argv[++count];
+
+        if (strcmp(option, "--threads") == 0) {
+            if (sscanf(value, "%d-%d", &config->min_threads, &config->max_threads) != 2)
+                config->max_threads = config->min_threads = atoi(value);
+        } else if (strcmp(option, "--ops") == 0)
+            config->ops = atol(value);
+        else if (strcmp(option, "--sample") == 0)
+            config->sample = atol(value);
+        else if (strcmp(option, "--warmup") == 0)
+            config->warmup = atoi(value);
+        else if (strcmp(option, "--repeats") == 0)
+            config->repeats = atoi(value);
+        else if (strcmp(option, "--format") == 0) {
+            if (strcmp(value, "csv") == 0)
+                config->format = BENCH_CSV;
+            else if (strcmp(value, "json") == 0)
+                config->format = BENCH_JSON;
+            else
+                config->format = BENCH_TEXT;
+        } else if (strcmp(option, "--filter") == 0)
+            config->filter = value;
+        else if (strcmp(option, "--save") == 0)
+            config->save = value;
+        else if (strcmp(option, "--baseline") == 0)
+            config->baseline = value;
+        else if (strcmp(option, "--tolerance") == 0)
+            config->tolerance = atof(value) / 100.0;
+        else {
+            bench_usage(argv[0]);
+            return EINVAL;
+        }
+    }
+
+    if (config->min_threads < 1 || config->max_threads > BENCH_MAX_THREADS
+        || config->min_threads > config->max_threads || config->ops < 1
+        || config->sample < 1 || config->repeats < 1 || config->warmup < 0) {
+        bench_usage(argv[0]);
+        return EINVAL;
+    }
+    return 0;
+}
+
+static void *bench_thread(void *arg)
+{
+    bench_thread_t *self = (bench_thread_t *)arg;
+    bench_config_t *config = self->config;
+    cpu_set_t cpus;
+    uint64_t chunk_start;
+    long done, chunk;
+
+    if (config->pin) {
+        CPU_ZERO(&cpus);
+        CPU_SET(self->index % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+
+    pthread_barrier_wait(self->barrier);
+    self->start = bench_now();
+    for (done = 0; done < config->ops; done += chunk) {
+        chunk = config->ops - done < config->sample ? config->ops - done : config->sample;
+        chunk_start = bench_now();
+        self->test->run(self->test->arg, self->index, chunk);
+        if (self->samples != NULL)
+            self->samples[self->nsamples++] = (double)(bench_now() - chunk_start) / chunk;
+    }
+    self->end = bench_now();
+    return NULL;
+}
+
+/*
+ * One timed run at the given thread count. Latency samples are
+ * appended to samples (when not NULL) at *nsamples. Throughput uses
+ * the span from the first thread starting to the last one finishing
+ * (plus finish), since the main thread may not run again until the
+ * workers are long done.
+ */
+static void bench_once(bench_config_t *config, bench_case_t *test, int threads,
+    double *samples, long *nsamples, double *ns_per_op, double *ops_per_sec)
+{
+    bench_thread_t workers[BENCH_MAX_THREADS];
+    pthread_barrier_t barrier;
+    uint64_t first = UINT64_MAX, last = 0, elapsed = 0;
+    long chunks = (config->ops + config->sample - 1) / config->sample;
+    int count, status;
+
+    status = pthread_barrier_init(&barrier, NULL, threads + 1);
+    if (status != 0)
+        err_abort(status, "Init bench barrier");
+
+    for (count = 0; count < threads; count++) {
+        workers[count].test = test;
+        workers[count].config = config;
+        workers[count].barrier = &barrier;
+        workers[count].index = count;
+        workers[count].samples = samples ? samples + *nsamples + count * chunks : NULL;
+        workers[count].nsamples = 0;
+        status = pthread_create(&workers[count].thread_id, NULL, bench_thread, &workers[count]);
+        if (status != 0)
+            err_abort(status, "Create bench thread");
+    }
+
+    pthread_barrier_wait(&barrier);
+    for (count = 0; count < threads; count++) {
+        status = pthread_join(workers[count].thread_id, NULL);
+        if (status != 0)
+            err_abort(status, "Join bench thread");
+        elapsed += workers[count].end - workers[count].start;
+        if (workers[count].start < first)
+            first = workers[count].start;
+        if (workers[count].end > last)
+            last = workers[count].end;
+    }
+    if (test->finish != NULL) {
+        test->finish(test->arg);
+        last = bench_now();
+    }
+
+    if (samples != NULL)
+        *nsamples += threads * chunks;
+    *ns_per_op = (double)elapsed / threads / config->ops;
+    *ops_per_sec = (double)threads * config->ops / ((last - first) / 1e9);
+    pthread_barrier_destroy(&barrier);
+}
+
+static int bench_measure(bench_config_t *config, bench_case_t *test, int threads,
+    bench_result_t *result)
+{
+    double ns[config->repeats], rates[config->repeats];
+    double *samples;
+    long nsamples = 0, chunks = (config->ops + config->sample - 1) / config->sample;
+    int repeat, status;
+
+    samples = (double *)malloc(config->repeats * threads * chunks * sizeof(double));
+    if (samples == NULL)
+        return ENOMEM;
+
+    if (test->setup != NULL) {
+        status = test->setup(test->arg, threads);
+        if (status != 0) {
+            free(samples);
+            return status;
+        }
+    }
+
+    for (repeat = 0; repeat < config->warmup; repeat++)
+        bench_once(config, test, threads, NULL, NULL, &ns[0], &rates[0]);
+    for (repeat = 0; repeat < config->repeats; repeat++)
+        bench_once(config, test, threads, samples, &nsamples, &ns[repeat], &rates[repeat]);
+
+    if (test->teardown != NULL)
+        test->teardown(test->arg);
+
+    snprintf(result->name, sizeof(result->name), "%s", test->name);
+    result->threads = threads;
+    result->ns_per_op = bench_percentile(ns, config->repeats, 0.5);
+    result->ops_per_sec = bench_percentile(rates, config->repeats, 0.5);
+    result->p50 = bench_percentile(samples, nsamples, 0.50);
+    result->p99 = bench_percentile(samples, nsamples, 0.99);
+
+    free(samples);
+    return 0;
+}
+
+static void bench_print(FILE *file, int format, bench_result_t *results, int nresults)
+{
+    int count;
+
+    if (format == BENCH_CSV)
+        fprintf(file, "case,threads,ns_per_op,ops_per_sec,p50_ns,p99_ns\n");
+    else if (format == BENCH_JSON)
+        fprintf(file, "[\n");
+    else
+        fprintf(file, "%-24s %7s %10s %14s %10s %10s\n", "case", "threads", "ns/op",
+            "ops/s", "p50 ns", "p99 ns");
+
+    for (count = 0; count < nresults; count++) {
+        bench_result_t *r = &results[count];
+
+        if (format == BENCH_CSV)
+            fprintf(file, "%s,%d,%.3f,%.0f,%.3f,%.3f\n", r->name, r->threads,
+                r->ns_per_op, r->ops_per_sec, r->p50, r->p99);
+        else if (format == BENCH_JSON)
+            fprintf(file, "  {\"case\": \"%s\", \"threads\": %d, \"ns_per_op\": %.3f, "
+                "\"ops_per_sec\": %.0f, \"p50_ns\": %.3f, \"p99_ns\": %.3f}%s\n",
+                r->name, r->threads, r->ns_per_op, r->ops_per_sec, r->p50, r->p99,
+                count + 1 < nresults ? "," : "");
+        else
+            fprintf(file, "%-24s %7d %10.2f %14.0f %10.2f %10.2f\n", r->name, r->threads,
+                r->ns_per_op, r->ops_per_sec, r->p50, r->p99);
+    }
+
+    if (format == BENCH_JSON)
+        fprintf(file, "]\n");
+}
+
+/*
+ * Compares ns/op with a CSV written by --save and returns the number of
+ * cases that got slower than the tolerance allows.
+ */
+static int bench_compare_baseline(bench_config_t *config, bench_result_t *results, int nresults)
+{
+    char line[256], name[64];
+    double ns, delta;
+    int threads, count, regressions = 0;
+    FILE *file;
+
+    file = fopen(config->baseline, "r");
+    if (file == NULL)
+        errno_abort("Open baseline");
+
+    fprintf(stderr, "%-24s %7s %10s %10s %8s\n", "case", "threads", "base ns", "ns", "delta");
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "%63[^,],%d,%lf", name, &threads, &ns) != 3)
+            continue;
+        for (count = 0; count < nresults; count++) {
+            if (results[count].threads != threads || strcmp(results[count].name, name) != 0)
+                continue;
+            delta = (results[count].ns_per_op - ns) / ns;
+            if (delta > config->tolerance)
+                regressions++;
+            fprintf(stderr, "%-24s %7d %10.2f %10.2f %+7.1f%%%s\n", name, threads, ns,
+                results[count].ns_per_op, delta * 100,
+                delta > config->tolerance ? "  REGRESSION" : "");
+        }
+    }
+
+    fclose(file);
+    return regressions;
+}
+
+int bench_run(bench_config_t *config, bench_case_t *cases, int ncases)
+{
+    bench_result_t *results;
+    FILE *file;
+    int test, threads, nresults = 0, status, regressions = 0;
+
+    results = (bench_result_t *)malloc(BENCH_MAX_RESULTS * sizeof(bench_result_t));
+    if (results == NULL)
+        errno_abort("Allocate bench results");
+
+    for (test = 0; test < ncases; test++) {
+        if (config->filter != NULL && strstr(cases[test].name, config->filter) == NULL)
+            continue;
+        for (threads = config->min_threads; threads <= config->max_threads; threads *= 2) {
+            if (nresults == BENCH_MAX_RESULTS)
+                break;
+            status = bench_measure(config, &cases[test], threads, &results[nresults]);
+            if (status != 0)
+                err_abort(status, "Run benchmark case");
+            nresults++;
+        }
+    }
+
+    bench_print(stdout, config->format, results, nresults);
+
+    if (config->save != NULL) {
+        file = fopen(config->save, "w");
+        if (file == NULL)
+            errno_abort("Open save file");
+        bench_print(file, BENCH_CSV, results, nresults);
+        fclose(file);
+    }
+
+    if (config->baseline != NULL)
+        regressions = bench_compare_baseline(config, results, nresults);
+
+    free(results);
+    return regressions;
+}
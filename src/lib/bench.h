@@ -0,0 +1,59 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#define BENCH_TEXT  0
+#define BENCH_CSV   1
+#define BENCH_JSON  2
+
+#define BENCH_MAX_THREADS   64
+#define BENCH_MAX_RESULTS   256
+
+typedef struct bench_config_tag {
+    int         warmup;
+    int         repeats;
+    int         min_threads;
+    int         max_threads;
+    int         pin;
+    long        ops;
+    long        sample;
+    int         format;
+    double      tolerance;
+    const char  *filter;
+    const char  *baseline;
+    const char  *save;
+} bench_config_t;
+
+/*
+ * A benchmark case. setup and teardown run once per thread count;
+ * run performs ops operations on behalf of thread index and is timed
+ * in chunks of config.sample operations to build the latency
+ * distribution; finish, if set, runs inside the timed region after
+ * all threads are done (for example to drain a queue).
+ */
+typedef struct bench_case_tag {
+    const char  *name;
+    int         (*setup)(void *arg, int threads);
+    void        (*run)(void *arg, int thread, long ops);
+    void        (*finish)(void *arg);
+    int         (*teardown)(void *arg);
+    void        *arg;
+} bench_case_t;
+
+typedef struct bench_result_tag {
+    char        name[64];
+    int         threads;
+    double      ns_per_op;
+    double      ops_per_sec;
+    double      p50;
+    double      p99;
+} bench_result_t;
+
+void bench_config_init(bench_config_t *config);
+int bench_parse_args(bench_config_t *config, int argc, char *argv[]);
+/*
+ * Runs every case matching config->filter at each thread count and
+ * returns the number of results that regressed against the baseline.
+ */
+int bench_run(bench_config_t *config, bench_case_t *cases, int ncases);
+
+#endif //BENCH_H
@@ -7,8 +7,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+extern void log_abort(const char *text, const char *file, int line, int code)
+	__attribute__((weak, noreturn));
+
 #define err_abort(code, text) \
 	do {\
+		if (log_abort)\
+			log_abort(text, __FILE__, __LINE__, code);\
 		fprintf(stderr, "%s at \"%s\":%d: %s\n",\
 			text, __FILE__, __LINE__, strerror(code));\
 		abort();\
@@ -16,9 +21,21 @@
 
 #define errno_abort(text) \
 	do {\
+		if (log_abort)\
+			log_abort(text, __FILE__, __LINE__, errno);\
 		fprintf(stderr, "%s at \"%s\":%d: %s\n",\
 			text, __FILE__, __LINE__, strerror(errno));\
 		abort();\
 	} while(0)
 
+#ifdef DEBUG
+# define DPRINTF(arg) printf arg
+#else
+# define DPRINTF(arg)
+#endif
+
+#ifdef LOCKDEP
+#include "lockdep.h"
+#endif
+
 #endif // ERRORS_H
\ No newline at end of file
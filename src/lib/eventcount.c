@@ -0,0 +1,134 @@
+#include <poll.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include "errors.h"
+#include "futex.h"
+#include "eventcount.h"
+
+int eventcount_init(eventcount_t *ec, int type)
+{
+    ec->epoch = 0;
+    ec->waiters = 0;
+    ec->fd = -1;
+
+    if (type == EVENTCOUNT_EVENTFD) {
+        ec->fd = eventfd(0, EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC);
+        if (ec->fd < 0)
+            return errno;
+    } else if (type != EVENTCOUNT_FUTEX)
+        return EINVAL;
+    return 0;
+}
+
+int eventcount_destroy(eventcount_t *ec)
+{
+    if (__atomic_load_n(&ec->waiters, __ATOMIC_ACQUIRE) != 0)
+        return EBUSY;
+    if (ec->fd >= 0 && close(ec->fd) != 0)
+        return errno;
+    ec->fd = -1;
+    return 0;
+}
+
+static uint64_t eventcount_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/*
+ * Slow path of eventcount_notify(): there is at least one waiter. The
+ * eventfd is a semaphore; each token written pays for a waiter claimed
+ * (removed) from the count, so that exactly that many tokens get read.
+ */
+void eventcount_wake(eventcount_t *ec, int count)
+{
+    uint64_t tokens;
+    int waiters;
+
+    __atomic_add_fetch(&ec->epoch, 1, __ATOMIC_SEQ_CST);
+    if (ec->fd < 0) {
+        futex_wake(&ec->epoch, count);
+        return;
+    }
+
+    waiters = __atomic_load_n(&ec->waiters, __ATOMIC_RELAXED);
+    do {
+        tokens = count < waiters ? count : waiters;
+        if (tokens == 0)
+            return;
+    } while (!__atomic_compare_exchange_n(&ec->waiters, &waiters, waiters - (int)tokens, 0,
+        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+    while (write(ec->fd, &tokens, sizeof(tokens)) < 0 && errno == EINTR)
+        ;
+}
+
+/*
+ * Ends an eventfd wait that has not read a token. If every remaining
+ * waiter has been claimed, one of the tokens on their way belongs to
+ * this thread, and it waits for and reads it.
+ */
+void eventcount_leave(eventcount_t *ec)
+{
+    struct pollfd poller;
+    uint64_t token;
+    int waiters;
+
+    waiters = __atomic_load_n(&ec->waiters, __ATOMIC_RELAXED);
+    while (waiters > 0)
+        if (__atomic_compare_exchange_n(&ec->waiters, &waiters, waiters - 1, 0,
+            __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            return;
+
+    poller.fd = ec->fd;
+    poller.events = POLLIN;
+    while (read(ec->fd, &token, sizeof(token)) != sizeof(token))
+        poll(&poller, 1, -1);
+}
+
+/*
+ * Commits a wait prepared with eventcount_prepare(). Returns 0 once the
+ * epoch has moved past key (or on an eventfd token, which the caller
+ * may see as a spurious wakeup), or ETIMEDOUT. The timeout is relative
+ * to the call, however many times the wait is interrupted.
+ */
+int eventcount_wait(eventcount_t *ec, int key, const struct timespec *timeout)
+{
+    struct timespec left;
+    struct pollfd poller;
+    uint64_t token, deadline = 0, now;
+    int status = 0, msec = -1, ready;
+
+    if (timeout != NULL)
+        deadline = eventcount_now() + timeout->tv_sec * 1000000000ULL + timeout->tv_nsec;
+
+    while (__atomic_load_n(&ec->epoch, __ATOMIC_ACQUIRE) == key) {
+        if (timeout != NULL) {
+            now = eventcount_now();
+            if (now >= deadline) {
+                status = ETIMEDOUT;
+                break;
+            }
+            left.tv_sec = (deadline - now) / 1000000000ULL;
+            left.tv_nsec = (deadline - now) % 1000000000ULL;
+            msec = (deadline - now + 999999) / 1000000;
+        }
+
+        if (ec->fd < 0) {
+            futex_wait(&ec->epoch, key, timeout != NULL ? &left : NULL);
+            continue;
+        }
+
+        poller.fd = ec->fd;
+        poller.events = POLLIN;
+        ready = poll(&poller, 1, msec);
+        if (ready > 0 && read(ec->fd, &token, sizeof(token)) == sizeof(token))
+            return 0;
+    }
+
+    eventcount_cancel(ec);
+    return status;
+}
@@ -0,0 +1,74 @@
+#ifndef EVENTCOUNT_H
+#define EVENTCOUNT_H
+
+#include <limits.h>
+#include <time.h>
+
+#define EVENTCOUNT_FUTEX    0
+#define EVENTCOUNT_EVENTFD  1
+
+/*
+ * Lets a consumer of a lock-free structure sleep until a producer has
+ * made a change, without a mutex:
+ *
+ *     key = eventcount_prepare(ec);
+ *     if (queue is not empty)
+ *         eventcount_cancel(ec);
+ *     else
+ *         eventcount_wait(ec, key, NULL);
+ *
+ * A producer publishes its change and then calls eventcount_notify(),
+ * which costs a fence and a load when nobody is waiting. A notify that
+ * comes after prepare makes the wait return at once.
+ *
+ * The EVENTCOUNT_EVENTFD variant parks waiters on an eventfd, which
+ * can also be added to an epoll set: after prepare and the re-check,
+ * wait in epoll_wait() and finish with eventcount_cancel() whether or
+ * not eventcount_fd() became readable. A wake claims waiters from the
+ * count and writes one token per claim; a waiter that was claimed reads
+ * its token on the way out, so none are left behind.
+ */
+typedef struct eventcount_tag {
+    int         epoch;
+    int         waiters;
+    int         fd;
+} eventcount_t;
+
+#define EVENTCOUNT_INITIALIZER {0, 0, -1}
+
+int eventcount_init(eventcount_t *ec, int type);
+int eventcount_destroy(eventcount_t *ec);
+int eventcount_wait(eventcount_t *ec, int key, const struct timespec *timeout);
+void eventcount_wake(eventcount_t *ec, int count);
+void eventcount_leave(eventcount_t *ec);
+
+static inline int eventcount_fd(eventcount_t *ec)
+{
+    return ec->fd;
+}
+
+static inline int eventcount_prepare(eventcount_t *ec)
+{
+    __atomic_fetch_add(&ec->waiters, 1, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&ec->epoch, __ATOMIC_SEQ_CST);
+}
+
+static inline void eventcount_cancel(eventcount_t *ec)
+{
+    if (ec->fd < 0)
+        __atomic_fetch_sub(&ec->waiters, 1, __ATOMIC_RELAXED);
+    else
+        eventcount_leave(ec);
+}
+
+static inline void eventcount_notify_count(eventcount_t *ec, int count)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ec->waiters, __ATOMIC_RELAXED) != 0)
+        eventcount_wake(ec, count);
+}
+
+#define eventcount_notify(ec)       eventcount_notify_count(ec, 1)
+#define eventcount_notify_all(ec)   eventcount_notify_count(ec, INT_MAX)
+
+#endif //EVENTCOUNT_H
@@ -0,0 +1,116 @@
+#include "errors.h"
+#include "futex.h"
+#include "fcond.h"
+
+void fmutex_init(fmutex_t *mutex)
+{
+    mutex->state = 0;
+}
+
+/*
+ * Takes the mutex marking it contended. Used after sleeping, and by
+ * waiters returning from a condition wait, who may have been requeued
+ * behind others.
+ */
+static void fmutex_lock_contended(fmutex_t *mutex)
+{
+    while (__atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE) != 0)
+        futex_wait(&mutex->state, 2, NULL);
+}
+
+void fmutex_lock(fmutex_t *mutex)
+{
+    int state = 0;
+
+    if (__atomic_compare_exchange_n(&mutex->state, &state, 1, 0,
+        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return;
+    fmutex_lock_contended(mutex);
+}
+
+int fmutex_trylock(fmutex_t *mutex)
+{
+    int state = 0;
+
+    return __atomic_compare_exchange_n(&mutex->state, &state, 1, 0,
+        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) ? 0 : EBUSY;
+}
+
+void fmutex_unlock(fmutex_t *mutex)
+{
+    if (__atomic_exchange_n(&mutex->state, 0, __ATOMIC_RELEASE) == 2)
+        futex_wake(&mutex->state, 1);
+}
+
+void fcond_init(fcond_t *cond)
+{
+    cond->seq = 0;
+    cond->waiters = 0;
+    cond->mutex = NULL;
+}
+
+int fcond_timedwait(fcond_t *cond, fmutex_t *mutex, const struct timespec *abstime)
+{
+    int seq, status = 0;
+
+    if (cond->mutex != mutex) {
+        if (cond->mutex != NULL && cond->waiters > 0)
+            return EINVAL;
+        cond->mutex = mutex;
+    }
+
+    __atomic_add_fetch(&cond->waiters, 1, __ATOMIC_RELAXED);
+    seq = __atomic_load_n(&cond->seq, __ATOMIC_RELAXED);
+    fmutex_unlock(mutex);
+
+    if (abstime == NULL)
+        futex_wait(&cond->seq, seq, NULL);
+    else if (futex_wait_until(&cond->seq, seq, abstime) != 0 && errno == ETIMEDOUT)
+        status = ETIMEDOUT;
+
+    __atomic_sub_fetch(&cond->waiters, 1, __ATOMIC_RELAXED);
+    fmutex_lock_contended(mutex);
+    return status;
+}
+
+int fcond_wait(fcond_t *cond, fmutex_t *mutex)
+{
+    return fcond_timedwait(cond, mutex, NULL);
+}
+
+/*
+ * Wakes up to count waiters. One is woken and the rest are requeued
+ * onto the mutex: the woken one locks with the contended state, so its
+ * unlock passes the mutex to the next, and so on.
+ */
+int fcond_wake(fcond_t *cond, int count)
+{
+    int seq;
+
+    if (count <= 0)
+        return EINVAL;
+    if (__atomic_load_n(&cond->waiters, __ATOMIC_ACQUIRE) == 0)
+        return 0;
+
+    seq = __atomic_add_fetch(&cond->seq, 1, __ATOMIC_RELEASE);
+    if (count == 1 || cond->mutex == NULL) {
+        futex_wake(&cond->seq, count);
+        return 0;
+    }
+
+    while (futex_cmp_requeue(&cond->seq, 1, count - 1, &cond->mutex->state, seq) < 0
+        && errno == EAGAIN) {
+        seq = __atomic_load_n(&cond->seq, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+int fcond_signal(fcond_t *cond)
+{
+    return fcond_wake(cond, 1);
+}
+
+int fcond_broadcast(fcond_t *cond)
+{
+    return fcond_wake(cond, INT_MAX);
+}
@@ -0,0 +1,43 @@
+#ifndef FCOND_H
+#define FCOND_H
+
+#include <time.h>
+
+/*
+ * A futex mutex: 0 unlocked, 1 locked, 2 locked with (possible)
+ * waiters. Unlock only enters the kernel from state 2.
+ */
+typedef struct fmutex_tag {
+    int         state;
+} fmutex_t;
+
+#define FMUTEX_INITIALIZER {0}
+
+/*
+ * A condition variable for fmutex_t. Waking with no waiters is a load
+ * and a branch. Waking several waiters wakes one and requeues the rest
+ * onto the mutex futex (wait morphing): each is woken by the unlock
+ * that hands it the mutex, instead of all of them waking at once only
+ * to block on the mutex again.
+ */
+typedef struct fcond_tag {
+    int         seq;
+    int         waiters;
+    fmutex_t    *mutex;
+} fcond_t;
+
+#define FCOND_INITIALIZER {0, 0, NULL}
+
+void fmutex_init(fmutex_t *mutex);
+void fmutex_lock(fmutex_t *mutex);
+int fmutex_trylock(fmutex_t *mutex);
+void fmutex_unlock(fmutex_t *mutex);
+
+void fcond_init(fcond_t *cond);
+int fcond_wait(fcond_t *cond, fmutex_t *mutex);
+int fcond_timedwait(fcond_t *cond, fmutex_t *mutex, const struct timespec *abstime);
+int fcond_wake(fcond_t *cond, int count);
+int fcond_signal(fcond_t *cond);
+int fcond_broadcast(fcond_t *cond);
+
+#endif //FCOND_H
@@ -0,0 +1,115 @@
+#include "errors.h"
+#include "forksafe.h"
+
+static pthread_once_t forksafe_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t forksafe_mutex = PTHREAD_MUTEX_INITIALIZER;
+static forksafe_t *forksafe_first = NULL, *forksafe_last = NULL;
+static int forksafe_status = 0;
+
+static void forksafe_prepare(void)
+{
+    forksafe_t *handler;
+    int status;
+
+    status = pthread_mutex_lock(&forksafe_mutex);
+    if (status != 0)
+        err_abort(status, "Lock fork registry");
+
+    for (handler = forksafe_first; handler != NULL; handler = handler->next)
+        if (handler->prepare != NULL)
+            handler->prepare(handler->arg);
+}
+
+static void forksafe_parent(void)
+{
+    forksafe_t *handler;
+    int status;
+
+    for (handler = forksafe_last; handler != NULL; handler = handler->prev)
+        if (handler->parent != NULL)
+            handler->parent(handler->arg);
+
+    status = pthread_mutex_unlock(&forksafe_mutex);
+    if (status != 0)
+        err_abort(status, "Unlock fork registry");
+}
+
+static void forksafe_child(void)
+{
+    forksafe_t *handler;
+    int status;
+
+    for (handler = forksafe_last; handler != NULL; handler = handler->prev)
+        if (handler->child != NULL)
+            handler->child(handler->arg);
+
+    status = pthread_mutex_unlock(&forksafe_mutex);
+    if (status != 0)
+        err_abort(status, "Unlock fork registry");
+}
+
+static void forksafe_init_routine(void)
+{
+    forksafe_status = pthread_atfork(forksafe_prepare, forksafe_parent, forksafe_child);
+}
+
+int forksafe_register(forksafe_t *handler, int rank, void (*prepare)(void *),
+    void (*parent)(void *), void (*child)(void *), void *arg)
+{
+    forksafe_t *next;
+    int status;
+
+    status = pthread_once(&forksafe_once, forksafe_init_routine);
+    if (status != 0)
+        return status;
+    if (forksafe_status != 0)
+        return forksafe_status;
+
+    handler->rank = rank;
+    handler->prepare = prepare;
+    handler->parent = parent;
+    handler->child = child;
+    handler->arg = arg;
+
+    status = pthread_mutex_lock(&forksafe_mutex);
+    if (status != 0)
+        return status;
+
+    for (next = forksafe_first; next != NULL; next = next->next)
+        if (next->rank > rank)
+            break;
+
+    handler->next = next;
+    handler->prev = (next != NULL) ? next->prev : forksafe_last;
+    if (handler->prev != NULL)
+        handler->prev->next = handler;
+    else
+        forksafe_first = handler;
+    if (next != NULL)
+        next->prev = handler;
+    else
+        forksafe_last = handler;
+
+    return pthread_mutex_unlock(&forksafe_mutex);
+}
+
+int forksafe_unregister(forksafe_t *handler)
+{
+    int status;
+
+    status = pthread_mutex_lock(&forksafe_mutex);
+    if (status != 0)
+        return status;
+
+    if (handler->prev != NULL)
+        handler->prev->next = handler->next;
+    else
+        forksafe_first = handler->next;
+    if (handler->next != NULL)
+        handler->next->prev = handler->prev;
+    else
+        forksafe_last = handler->prev;
+    handler->next = handler->prev = NULL;
+
+    return pthread_mutex_unlock(&forksafe_mutex);
+}
@@ -0,0 +1,30 @@
+#ifndef FORKSAFE_H
+#define FORKSAFE_H
+
+#include <pthread.h>
+
+/*
+ * Subsystems register fork handlers with a rank. Before fork() the
+ * prepare handlers run in increasing rank order, so a subsystem whose
+ * locks are taken while holding another's must register with the
+ * higher rank. The parent and child handlers run in the reverse order.
+ */
+#define FORKSAFE_RANK_WORKQ     100
+#define FORKSAFE_RANK_TIMER     200
+#define FORKSAFE_RANK_SLAB      800
+#define FORKSAFE_RANK_LOG       900
+
+typedef struct forksafe_tag {
+    struct forksafe_tag     *next, *prev;
+    int                     rank;
+    void                    (*prepare)(void *);
+    void                    (*parent)(void *);
+    void                    (*child)(void *);
+    void                    *arg;
+} forksafe_t;
+
+int forksafe_register(forksafe_t *handler, int rank, void (*prepare)(void *),
+    void (*parent)(void *), void (*child)(void *), void *arg);
+int forksafe_unregister(forksafe_t *handler);
+
+#endif //FORKSAFE_H
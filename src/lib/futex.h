@@ -0,0 +1,40 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+static inline int futex_wait(int *addr, int value, const struct timespec *timeout)
+{
+    return syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, timeout, NULL, 0);
+}
+
+static inline int futex_wake(int *addr, int count)
+{
+    return syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+/*
+ * Waits until an absolute CLOCK_REALTIME deadline, as
+ * pthread_cond_timedwait() does.
+ */
+static inline int futex_wait_until(int *addr, int value, const struct timespec *abstime)
+{
+    return syscall(SYS_futex, addr, FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME,
+        value, abstime, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+/*
+ * Wakes up to wake waiters on addr and moves up to requeue more onto
+ * target, provided *addr still equals value.
+ */
+static inline int futex_cmp_requeue(int *addr, int wake, int requeue, int *target, int value)
+{
+    return syscall(SYS_futex, addr, FUTEX_CMP_REQUEUE_PRIVATE, wake,
+        (void *)(long)requeue, target, value);
+}
+
+#endif //FUTEX_H
@@ -0,0 +1,37 @@
+#include "errors.h"
+#include "futex.h"
+#include "lazy.h"
+
+int once_call_slow(once_t *once, int (*init)(void *, void **), void *arg, void **value)
+{
+    int state, status;
+
+    while (1) {
+        state = ONCE_INIT;
+        if (__atomic_compare_exchange_n(&once->state, &state, ONCE_RUNNING, 0,
+            __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+            break;
+
+        if (state == ONCE_DONE) {
+            *value = once->value;
+            return 0;
+        }
+
+        if (state == ONCE_RUNNING
+            && !__atomic_compare_exchange_n(&once->state, &state, ONCE_WAITING, 0,
+                __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+            continue;
+
+        futex_wait(&once->state, ONCE_WAITING, NULL);
+    }
+
+    status = init(arg, &once->value);
+    state = __atomic_exchange_n(&once->state, status == 0 ? ONCE_DONE : ONCE_INIT,
+        __ATOMIC_RELEASE);
+    if (state == ONCE_WAITING)
+        futex_wake(&once->state, INT_MAX);
+
+    if (status == 0)
+        *value = once->value;
+    return status;
+}
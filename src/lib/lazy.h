@@ -0,0 +1,49 @@
+#ifndef LAZY_H
+#define LAZY_H
+
+#define ONCE_INIT       0
+#define ONCE_RUNNING    1
+#define ONCE_WAITING    2
+#define ONCE_DONE       3
+
+typedef struct once_tag {
+    int         state;
+    void        *value;
+} once_t;
+
+#define ONCE_INITIALIZER {ONCE_INIT, NULL}
+
+int once_call_slow(once_t *once, int (*init)(void *, void **), void *arg, void **value);
+
+/*
+ * Runs init(arg, &value) exactly once. If init returns non-zero the
+ * attempt is abandoned, the error is returned to that caller and the
+ * next caller (including any blocked waiter) tries again.
+ */
+static inline int once_call(once_t *once, int (*init)(void *, void **), void *arg, void **value)
+{
+    if (__atomic_load_n(&once->state, __ATOMIC_ACQUIRE) == ONCE_DONE) {
+        *value = once->value;
+        return 0;
+    }
+
+    return once_call_slow(once, init, arg, value);
+}
+
+#define LAZY_STATIC(type, name, init_fn) \
+    static int name##_lazy_init(void *arg, void **value) \
+    { \
+        static type storage; \
+        int status = init_fn(&storage); \
+        if (status == 0) \
+            *value = &storage; \
+        return status; \
+    } \
+    static type *name(void) \
+    { \
+        static once_t once = ONCE_INITIALIZER; \
+        void *value; \
+        return once_call(&once, name##_lazy_init, NULL, &value) == 0 ? (type *)value : NULL; \
+    }
+
+#endif //LAZY_H
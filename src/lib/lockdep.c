@@ -0,0 +1,274 @@
+#define LOCKDEP_IMPL
+#include <stdint.h>
+#include "errors.h"
+#include "lockdep.h"
+
+typedef struct lockdep_edge_tag {
+    struct lockdep_edge_tag *next;
+    struct lockdep_node_tag *to;
+    const char              *from_file;
+    int                     from_line;
+    const char              *to_file;
+    int                     to_line;
+} lockdep_edge_t;
+
+typedef struct lockdep_node_tag {
+    struct lockdep_node_tag *next;
+    const void              *lock;
+    lockdep_edge_t          *edges;
+    unsigned long           visit;
+} lockdep_node_t;
+
+typedef struct lockdep_held_tag {
+    const void  *lock;
+    const char  *file;
+    int         line;
+} lockdep_held_t;
+
+typedef struct lockdep_cache_tag {
+    const void      *from;
+    const void      *to;
+    unsigned long   generation;
+} lockdep_cache_t;
+
+static pthread_mutex_t lockdep_mutex = PTHREAD_MUTEX_INITIALIZER;
+static lockdep_node_t *lockdep_table[LOCKDEP_BUCKETS];
+static unsigned long lockdep_visit = 0;
+static unsigned long lockdep_generation = 1;
+static unsigned long lockdep_inversion_count = 0;
+
+static __thread lockdep_held_t held[LOCKDEP_MAX_HELD];
+static __thread int held_depth = 0;
+static __thread int held_disabled = 0;
+static __thread lockdep_cache_t cache[LOCKDEP_CACHE];
+
+static unsigned int lockdep_hash(const void *lock)
+{
+    uintptr_t value = (uintptr_t)lock;
+
+    value ^= value >> 17;
+    value *= 0x9e3779b1U;
+    return (unsigned int)(value >> 7);
+}
+
+static lockdep_node_t *lockdep_node(const void *lock, int create)
+{
+    lockdep_node_t **bucket, *node;
+
+    bucket = &lockdep_table[lockdep_hash(lock) % LOCKDEP_BUCKETS];
+    for (node = *bucket; node != NULL; node = node->next)
+        if (node->lock == lock)
+            return node;
+
+    if (!create)
+        return NULL;
+
+    node = (lockdep_node_t *)calloc(1, sizeof(lockdep_node_t));
+    if (node == NULL)
+        errno_abort("Allocate lockdep node");
+
+    node->lock = lock;
+    node->next = *bucket;
+    *bucket = node;
+    return node;
+}
+
+static lockdep_edge_t *lockdep_path(lockdep_node_t *from, lockdep_node_t *to,
+    lockdep_edge_t **path, int *depth)
+{
+    lockdep_edge_t *edge, *found;
+
+    if (from->visit == lockdep_visit)
+        return NULL;
+    from->visit = lockdep_visit;
+
+    for (edge = from->edges; edge != NULL; edge = edge->next) {
+        if (*depth < LOCKDEP_MAX_HELD)
+            path[*depth] = edge;
+        (*depth)++;
+
+        if (edge->to == to)
+            return edge;
+
+        found = lockdep_path(edge->to, to, path, depth);
+        if (found != NULL)
+            return found;
+
+        (*depth)--;
+    }
+
+    return NULL;
+}
+
+static void lockdep_report(lockdep_held_t *holding, const void *lock,
+    const char *file, int line, lockdep_edge_t **path, int depth)
+{
+    int count;
+
+    fprintf(stderr, "lockdep: lock order inversion detected\n");
+    fprintf(stderr, "  acquiring %p at \"%s\":%d\n", lock, file, line);
+    fprintf(stderr, "  while holding %p acquired at \"%s\":%d\n",
+        holding->lock, holding->file, holding->line);
+    fprintf(stderr, "  existing order:\n");
+
+    if (depth > LOCKDEP_MAX_HELD)
+        depth = LOCKDEP_MAX_HELD;
+    for (count = 0; count < depth; count++)
+        fprintf(stderr, "    %p (\"%s\":%d) -> %p (\"%s\":%d)\n",
+            count == 0 ? lock : path[count - 1]->to->lock,
+            path[count]->from_file, path[count]->from_line,
+            path[count]->to->lock, path[count]->to_file, path[count]->to_line);
+}
+
+static void lockdep_link(lockdep_held_t *holding, const void *lock, const char *file, int line)
+{
+    lockdep_edge_t *path[LOCKDEP_MAX_HELD];
+    lockdep_node_t *from, *to;
+    lockdep_edge_t *edge;
+    int depth = 0;
+
+    from = lockdep_node(holding->lock, 1);
+    to = lockdep_node(lock, 1);
+
+    for (edge = from->edges; edge != NULL; edge = edge->next)
+        if (edge->to == to)
+            return;
+
+    lockdep_visit++;
+    if (lockdep_path(to, from, path, &depth) != NULL) {
+        lockdep_inversion_count++;
+        lockdep_report(holding, lock, file, line, path, depth);
+    }
+
+    edge = (lockdep_edge_t *)malloc(sizeof(lockdep_edge_t));
+    if (edge == NULL)
+        errno_abort("Allocate lockdep edge");
+
+    edge->to = to;
+    edge->from_file = holding->file;
+    edge->from_line = holding->line;
+    edge->to_file = file;
+    edge->to_line = line;
+    edge->next = from->edges;
+    from->edges = edge;
+}
+
+void lockdep_acquire(const void *lock, int trylock, const char *file, int line)
+{
+    lockdep_cache_t *entry;
+    unsigned long generation;
+    int count, locked = 0;
+
+    if (held_disabled)
+        return;
+
+    /*
+     * Past the stack limit the thread's held set is no longer known, so
+     * it is dropped for good rather than guessed at on each release.
+     */
+    if (held_depth == LOCKDEP_MAX_HELD) {
+        fprintf(stderr, "lockdep: more than %d locks held, tracking disabled for this thread\n",
+            LOCKDEP_MAX_HELD);
+        held_disabled = 1;
+        held_depth = 0;
+        return;
+    }
+
+    if (!trylock) {
+        generation = __atomic_load_n(&lockdep_generation, __ATOMIC_ACQUIRE);
+
+        for (count = 0; count < held_depth; count++) {
+            entry = &cache[(lockdep_hash(held[count].lock) ^ lockdep_hash(lock)) % LOCKDEP_CACHE];
+            if (entry->from == held[count].lock && entry->to == lock
+                && entry->generation == generation)
+                continue;
+
+            if (!locked) {
+                pthread_mutex_lock(&lockdep_mutex);
+                locked = 1;
+            }
+
+            lockdep_link(&held[count], lock, file, line);
+            entry->from = held[count].lock;
+            entry->to = lock;
+            entry->generation = generation;
+        }
+
+        if (locked)
+            pthread_mutex_unlock(&lockdep_mutex);
+    }
+
+    held[held_depth].lock = lock;
+    held[held_depth].file = file;
+    held[held_depth].line = line;
+    held_depth++;
+}
+
+void lockdep_release(const void *lock)
+{
+    int count;
+
+    if (held_disabled)
+        return;
+
+    for (count = held_depth - 1; count >= 0; count--) {
+        if (held[count].lock == lock) {
+            held_depth--;
+            for (; count < held_depth; count++)
+                held[count] = held[count + 1];
+            return;
+        }
+    }
+}
+
+void lockdep_forget(const void *lock)
+{
+    lockdep_node_t **last, *node, *victim;
+    lockdep_edge_t **link, *edge;
+    int bucket;
+
+    pthread_mutex_lock(&lockdep_mutex);
+
+    victim = lockdep_node(lock, 0);
+    if (victim == NULL) {
+        pthread_mutex_unlock(&lockdep_mutex);
+        return;
+    }
+
+    for (bucket = 0; bucket < LOCKDEP_BUCKETS; bucket++) {
+        for (node = lockdep_table[bucket]; node != NULL; node = node->next) {
+            link = &node->edges;
+            while ((edge = *link) != NULL) {
+                if (edge->to == victim) {
+                    *link = edge->next;
+                    free(edge);
+                } else
+                    link = &edge->next;
+            }
+        }
+    }
+
+    last = &lockdep_table[lockdep_hash(lock) % LOCKDEP_BUCKETS];
+    while (*last != victim)
+        last = &(*last)->next;
+    *last = victim->next;
+
+    while ((edge = victim->edges) != NULL) {
+        victim->edges = edge->next;
+        free(edge);
+    }
+    free(victim);
+
+    __atomic_add_fetch(&lockdep_generation, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&lockdep_mutex);
+}
+
+unsigned long lockdep_inversions(void)
+{
+    unsigned long count;
+
+    pthread_mutex_lock(&lockdep_mutex);
+    count = lockdep_inversion_count;
+    pthread_mutex_unlock(&lockdep_mutex);
+    return count;
+}
@@ -0,0 +1,62 @@
+#ifndef LOCKDEP_H
+#define LOCKDEP_H
+
+#include <pthread.h>
+
+#define LOCKDEP_MAX_HELD    32
+#define LOCKDEP_BUCKETS     1024
+#define LOCKDEP_CACHE       256
+
+void lockdep_acquire(const void *lock, int trylock, const char *file, int line);
+void lockdep_release(const void *lock);
+void lockdep_forget(const void *lock);
+unsigned long lockdep_inversions(void);
+
+/*
+ * Building with -DLOCKDEP routes pthread_mutex_* calls made from any file
+ * that includes this header (errors.h does) through the validator, so that
+ * every acquisition is checked against the acquired-before graph first.
+ */
+#if defined(LOCKDEP) && !defined(LOCKDEP_IMPL)
+
+static inline int lockdep_mutex_lock(pthread_mutex_t *mutex, const char *file, int line)
+{
+    int status;
+
+    lockdep_acquire(mutex, 0, file, line);
+    status = pthread_mutex_lock(mutex);
+    if (status != 0)
+        lockdep_release(mutex);
+    return status;
+}
+
+static inline int lockdep_mutex_trylock(pthread_mutex_t *mutex, const char *file, int line)
+{
+    int status;
+
+    status = pthread_mutex_trylock(mutex);
+    if (status == 0)
+        lockdep_acquire(mutex, 1, file, line);
+    return status;
+}
+
+static inline int lockdep_mutex_unlock(pthread_mutex_t *mutex)
+{
+    lockdep_release(mutex);
+    return pthread_mutex_unlock(mutex);
+}
+
+static inline int lockdep_mutex_destroy(pthread_mutex_t *mutex)
+{
+    lockdep_forget(mutex);
+    return pthread_mutex_destroy(mutex);
+}
+
+#define pthread_mutex_lock(mutex)       lockdep_mutex_lock(mutex, __FILE__, __LINE__)
+#define pthread_mutex_trylock(mutex)    lockdep_mutex_trylock(mutex, __FILE__, __LINE__)
+#define pthread_mutex_unlock(mutex)     lockdep_mutex_unlock(mutex)
+#define pthread_mutex_destroy(mutex)    lockdep_mutex_destroy(mutex)
+
+#endif
+
+#endif //LOCKDEP_H
@@ -0,0 +1,115 @@
+#include <time.h>
+#include "errors.h"
+#include "lockset.h"
+
+static __thread unsigned int backoff_seed;
+
+static void lock_sort(pthread_mutex_t **set, int n)
+{
+    pthread_mutex_t *mutex;
+    int i, j;
+
+    for (i = 1; i < n; i++) {
+        mutex = set[i];
+        for (j = i; j > 0 && set[j - 1] > mutex; j--)
+            set[j] = set[j - 1];
+        set[j] = mutex;
+    }
+}
+
+static void lock_release(pthread_mutex_t **set, int held)
+{
+    while (--held >= 0)
+        pthread_mutex_unlock(set[held]);
+}
+
+static int lock_ordered(pthread_mutex_t **set, int n)
+{
+    pthread_mutex_t *sorted[LOCK_MANY_MAX];
+    int count, status;
+
+    memcpy(sorted, set, n * sizeof(pthread_mutex_t *));
+    lock_sort(sorted, n);
+
+    for (count = 0; count < n; count++) {
+        status = pthread_mutex_lock(sorted[count]);
+        if (status != 0) {
+            lock_release(sorted, count);
+            return status;
+        }
+    }
+
+    return 0;
+}
+
+static void lock_delay(long limit)
+{
+    struct timespec delay;
+
+    if (backoff_seed == 0)
+        backoff_seed = (unsigned int)(unsigned long)pthread_self();
+
+    delay.tv_sec = 0;
+    delay.tv_nsec = rand_r(&backoff_seed) % limit;
+    nanosleep(&delay, NULL);
+}
+
+static int lock_backoff(pthread_mutex_t **set, int n, unsigned long *backoffs)
+{
+    long limit = LOCK_BACKOFF_MIN_NSEC;
+    int count, status;
+
+    while (1) {
+        status = pthread_mutex_lock(set[0]);
+        if (status != 0)
+            return status;
+
+        for (count = 1; count < n; count++) {
+            status = pthread_mutex_trylock(set[count]);
+            if (status != 0)
+                break;
+        }
+
+        if (count == n)
+            return 0;
+
+        lock_release(set, count);
+        if (status != EBUSY)
+            return status;
+
+        if (backoffs != NULL)
+            (*backoffs)++;
+
+        lock_delay(limit);
+        if (limit < LOCK_BACKOFF_MAX_NSEC)
+            limit *= 2;
+    }
+}
+
+int lock_many(pthread_mutex_t **set, int n, int policy, unsigned long *backoffs)
+{
+    if (n < 1 || n > LOCK_MANY_MAX)
+        return EINVAL;
+
+    switch (policy) {
+    case LOCK_ORDERED:
+        return lock_ordered(set, n);
+    case LOCK_BACKOFF:
+        return lock_backoff(set, n, backoffs);
+    default:
+        return EINVAL;
+    }
+}
+
+int unlock_many(pthread_mutex_t **set, int n)
+{
+    int count, status, result = 0;
+
+    for (count = n - 1; count >= 0; count--) {
+        status = pthread_mutex_unlock(set[count]);
+        if (status != 0 && result == 0)
+            result = status;
+    }
+
+    return result;
+}
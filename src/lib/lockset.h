@@ -0,0 +1,16 @@
+#ifndef LOCKSET_H
+#define LOCKSET_H
+
+#include <pthread.h>
+
+#define LOCK_ORDERED    0
+#define LOCK_BACKOFF    1
+
+#define LOCK_MANY_MAX           16
+#define LOCK_BACKOFF_MIN_NSEC   1000
+#define LOCK_BACKOFF_MAX_NSEC   1000000
+
+int lock_many(pthread_mutex_t **set, int n, int policy, unsigned long *backoffs);
+int unlock_many(pthread_mutex_t **set, int n);
+
+#endif //LOCKSET_H
@@ -0,0 +1,451 @@
+#include <pthread.h>
+#include <stdarg.h>
+#include <sys/uio.h>
+#include <time.h>
+#include "errors.h"
+#include "forksafe.h"
+#include "log.h"
+
+typedef struct log_ring_tag {
+    struct log_ring_tag *next;
+    unsigned long       head;
+    int                 dead;
+    char                pad[64 - sizeof(void *) - sizeof(unsigned long) - sizeof(int)];
+    unsigned long       tail;
+    char                data[LOG_RING_SIZE];
+} __attribute__((aligned(64))) log_ring_t;
+
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t log_space_cv = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t log_write_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t log_flusher;
+static log_ring_t *log_rings = NULL;
+static int log_fd = -1;
+static int log_policy = LOG_DROP;
+static int log_kick = 0, log_quit = 0, log_blocked = 0;
+static size_t log_budget = 0;
+static size_t log_pending = 0;
+static unsigned long log_drops = 0;
+static forksafe_t log_fork;
+
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_key_t log_exit_key;
+static __thread log_ring_t *log_self = NULL;
+
+static void log_thread_exit(void *arg)
+{
+    __atomic_store_n(&((log_ring_t *)arg)->dead, 1, __ATOMIC_RELEASE);
+}
+
+static void log_init_routine(void)
+{
+    int status;
+
+    status = pthread_key_create(&log_exit_key, log_thread_exit);
+    if (status != 0)
+        err_abort(status, "Create log key");
+}
+
+static log_ring_t *log_attach(void)
+{
+    log_ring_t *ring;
+
+    if (pthread_once(&log_once, log_init_routine) != 0)
+        return NULL;
+
+    if (posix_memalign((void **)&ring, 64, sizeof(log_ring_t)) != 0)
+        return NULL;
+
+    ring->head = ring->tail = 0;
+    ring->dead = 0;
+    if (pthread_setspecific(log_exit_key, ring) != 0) {
+        free(ring);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&log_mutex);
+    ring->next = log_rings;
+    __atomic_store_n(&log_rings, ring, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&log_mutex);
+
+    log_self = ring;
+    return ring;
+}
+
+static void log_wakeup(void)
+{
+    pthread_mutex_lock(&log_mutex);
+    log_kick = 1;
+    pthread_cond_signal(&log_cv);
+    pthread_mutex_unlock(&log_mutex);
+}
+
+static int log_writev(struct iovec *iov, int count)
+{
+    ssize_t bytes;
+
+    while (count > 0) {
+        bytes = writev(log_fd, iov, count);
+        if (bytes < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+
+        while (count > 0 && (size_t)bytes >= iov->iov_len) {
+            bytes -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + bytes;
+            iov->iov_len -= bytes;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Writes out everything appended so far. Only one thread at a time
+ * consumes the rings, serialized by log_write_mutex.
+ */
+static int log_drain_locked(void)
+{
+    struct iovec iov[LOG_IOV_MAX];
+    log_ring_t *rings[LOG_IOV_MAX / 2], *ring, **last;
+    unsigned long heads[LOG_IOV_MAX / 2];
+    unsigned long head, tail, offset;
+    size_t bytes;
+    int count, nrings, index, status = 0, result = 0;
+
+    ring = __atomic_load_n(&log_rings, __ATOMIC_ACQUIRE);
+    while (ring != NULL) {
+        count = nrings = 0;
+        bytes = 0;
+        for (; ring != NULL && nrings < LOG_IOV_MAX / 2; ring = ring->next) {
+            head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            tail = ring->tail;
+            if (head == tail)
+                continue;
+
+            offset = tail % LOG_RING_SIZE;
+            if (offset + (head - tail) <= LOG_RING_SIZE) {
+                iov[count].iov_base = ring->data + offset;
+                iov[count++].iov_len = head - tail;
+            } else {
+                iov[count].iov_base = ring->data + offset;
+                iov[count++].iov_len = LOG_RING_SIZE - offset;
+                iov[count].iov_base = ring->data;
+                iov[count++].iov_len = head % LOG_RING_SIZE;
+            }
+            bytes += head - tail;
+            rings[nrings] = ring;
+            heads[nrings++] = head;
+        }
+
+        if (count == 0)
+            break;
+
+        status = log_writev(iov, count);
+        if (status != 0)
+            result = status;
+
+        for (index = 0; index < nrings; index++)
+            __atomic_store_n(&rings[index]->tail, heads[index], __ATOMIC_RELEASE);
+        __atomic_sub_fetch(&log_pending, bytes, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_lock(&log_mutex);
+    for (last = &log_rings; *last != NULL;) {
+        ring = *last;
+        if (__atomic_load_n(&ring->dead, __ATOMIC_ACQUIRE)
+            && ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+            *last = ring->next;
+            free(ring);
+        } else
+            last = &ring->next;
+    }
+    if (log_blocked > 0)
+        pthread_cond_broadcast(&log_space_cv);
+    pthread_mutex_unlock(&log_mutex);
+
+    return result;
+}
+
+static void *log_flush_thread(void *arg)
+{
+    struct timespec timeout;
+
+    pthread_mutex_lock(&log_mutex);
+    while (!log_quit) {
+        if (!log_kick) {
+            clock_gettime(CLOCK_REALTIME, &timeout);
+            timeout.tv_nsec += LOG_INTERVAL_MSEC * 1000000L;
+            if (timeout.tv_nsec >= 1000000000L) {
+                timeout.tv_sec++;
+                timeout.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&log_cv, &log_mutex, &timeout);
+        }
+        log_kick = 0;
+        pthread_mutex_unlock(&log_mutex);
+
+        pthread_mutex_lock(&log_write_mutex);
+        log_drain_locked();
+        pthread_mutex_unlock(&log_write_mutex);
+
+        pthread_mutex_lock(&log_mutex);
+    }
+    pthread_mutex_unlock(&log_mutex);
+    return NULL;
+}
+
+/*
+ * The flusher takes log_write_mutex after dropping log_mutex, but a
+ * drain takes log_mutex while holding log_write_mutex.
+ */
+static void log_fork_prepare(void *arg)
+{
+    int status;
+
+    status = pthread_mutex_lock(&log_write_mutex);
+    if (status != 0)
+        err_abort(status, "Lock log writer in prepare handler");
+    status = pthread_mutex_lock(&log_mutex);
+    if (status != 0)
+        err_abort(status, "Lock log in prepare handler");
+}
+
+static void log_fork_parent(void *arg)
+{
+    int status;
+
+    status = pthread_mutex_unlock(&log_mutex);
+    if (status != 0)
+        err_abort(status, "Unlock log in parent handler");
+    status = pthread_mutex_unlock(&log_write_mutex);
+    if (status != 0)
+        err_abort(status, "Unlock log writer in parent handler");
+}
+
+/*
+ * The parent still owns everything buffered before the fork, so the
+ * child discards it rather than write it twice, lets the rings of the
+ * threads it did not inherit be freed, and starts its own flusher.
+ */
+static void log_fork_child(void *arg)
+{
+    log_ring_t *ring;
+    int status;
+
+    for (ring = log_rings; ring != NULL; ring = ring->next) {
+        ring->tail = ring->head;
+        if (ring != log_self)
+            ring->dead = 1;
+    }
+    log_pending = 0;
+    log_blocked = 0;
+    log_kick = 0;
+
+    status = pthread_cond_init(&log_cv, NULL);
+    if (status == 0)
+        status = pthread_cond_init(&log_space_cv, NULL);
+    if (status != 0)
+        err_abort(status, "Reinit log conditions in child handler");
+
+    if (log_fd >= 0 && pthread_create(&log_flusher, NULL, log_flush_thread, NULL) != 0)
+        log_fd = -1;
+
+    status = pthread_mutex_unlock(&log_mutex);
+    if (status != 0)
+        err_abort(status, "Unlock log in child handler");
+    status = pthread_mutex_unlock(&log_write_mutex);
+    if (status != 0)
+        err_abort(status, "Unlock log writer in child handler");
+}
+
+int log_open(int fd, size_t budget, int policy)
+{
+    int status;
+
+    if (fd < 0 || budget < LOG_LINE_MAX || (policy != LOG_DROP && policy != LOG_BLOCK))
+        return EINVAL;
+    if (log_fd >= 0)
+        return EBUSY;
+
+    log_budget = budget;
+    log_policy = policy;
+    log_quit = log_kick = 0;
+    log_fd = fd;
+
+    status = forksafe_register(&log_fork, FORKSAFE_RANK_LOG,
+        log_fork_prepare, log_fork_parent, log_fork_child, NULL);
+    if (status != 0) {
+        log_fd = -1;
+        return status;
+    }
+
+    status = pthread_create(&log_flusher, NULL, log_flush_thread, NULL);
+    if (status != 0) {
+        forksafe_unregister(&log_fork);
+        log_fd = -1;
+    }
+    return status;
+}
+
+int log_close(void)
+{
+    int status;
+
+    if (log_fd < 0)
+        return EINVAL;
+
+    pthread_mutex_lock(&log_mutex);
+    log_quit = 1;
+    pthread_cond_signal(&log_cv);
+    pthread_mutex_unlock(&log_mutex);
+
+    status = pthread_join(log_flusher, NULL);
+    if (status != 0)
+        return status;
+
+    status = forksafe_unregister(&log_fork);
+    if (status != 0)
+        return status;
+
+    status = log_flush();
+    log_fd = -1;
+    return status;
+}
+
+static int log_fits(log_ring_t *ring, size_t size)
+{
+    return LOG_RING_SIZE - (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) >= size
+        && __atomic_load_n(&log_pending, __ATOMIC_RELAXED) + size <= log_budget;
+}
+
+static void log_wait_space(log_ring_t *ring, size_t size)
+{
+    pthread_mutex_lock(&log_mutex);
+    log_blocked++;
+    log_kick = 1;
+    pthread_cond_signal(&log_cv);
+    while (!log_fits(ring, size) && !log_quit)
+        pthread_cond_wait(&log_space_cv, &log_mutex);
+    log_blocked--;
+    pthread_mutex_unlock(&log_mutex);
+}
+
+int log_write(const char *record, size_t size)
+{
+    log_ring_t *ring = log_self;
+    unsigned long head, tail, offset;
+    size_t pending, first;
+
+    if (log_fd < 0)
+        return EINVAL;
+    if (size > LOG_RING_SIZE || size > log_budget)
+        return E2BIG;
+    if (ring == NULL && (ring = log_attach()) == NULL)
+        return ENOMEM;
+
+    head = ring->head;
+    while (1) {
+        tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (LOG_RING_SIZE - (head - tail) >= size) {
+            pending = __atomic_add_fetch(&log_pending, size, __ATOMIC_RELAXED);
+            if (pending <= log_budget)
+                break;
+            __atomic_sub_fetch(&log_pending, size, __ATOMIC_RELAXED);
+        }
+
+        if (log_policy == LOG_DROP) {
+            __atomic_fetch_add(&log_drops, 1, __ATOMIC_RELAXED);
+            log_wakeup();
+            return EAGAIN;
+        }
+        log_wait_space(ring, size);
+        if (log_quit)
+            return EPIPE;
+    }
+
+    offset = head % LOG_RING_SIZE;
+    first = LOG_RING_SIZE - offset < size ? LOG_RING_SIZE - offset : size;
+    memcpy(ring->data + offset, record, first);
+    memcpy(ring->data, record + first, size - first);
+    __atomic_store_n(&ring->head, head + size, __ATOMIC_RELEASE);
+
+    if (head - tail < LOG_RING_SIZE / 2 && head + size - tail >= LOG_RING_SIZE / 2)
+        log_wakeup();
+    else if (pending - size < log_budget / 2 && pending >= log_budget / 2)
+        log_wakeup();
+    return 0;
+}
+
+int log_printf(const char *format, ...)
+{
+    char record[LOG_LINE_MAX];
+    va_list ap;
+    int size;
+
+    va_start(ap, format);
+    size = vsnprintf(record, sizeof(record), format, ap);
+    va_end(ap);
+
+    if (size < 0)
+        return EINVAL;
+    if (size >= (int)sizeof(record))
+        size = sizeof(record) - 1;
+    return log_write(record, size);
+}
+
+int log_flush(void)
+{
+    int status;
+
+    status = pthread_mutex_lock(&log_write_mutex);
+    if (status != 0)
+        return status;
+
+    status = log_drain_locked();
+    pthread_mutex_unlock(&log_write_mutex);
+    return status;
+}
+
+unsigned long log_dropped(void)
+{
+    return __atomic_load_n(&log_drops, __ATOMIC_RELAXED);
+}
+
+/*
+ * Called by err_abort()/errno_abort() when the log writer is linked in.
+ * Buffered records are written before the message, so the trail leading
+ * up to the failure is not lost.
+ */
+void log_abort(const char *text, const char *file, int line, int code)
+{
+    struct timespec timeout;
+    char record[LOG_LINE_MAX];
+    int size;
+
+    size = snprintf(record, sizeof(record), "%s at \"%s\":%d: %s\n",
+        text, file, line, strerror(code));
+    if (size >= (int)sizeof(record))
+        size = sizeof(record) - 1;
+
+    if (log_fd >= 0) {
+        clock_gettime(CLOCK_REALTIME, &timeout);
+        timeout.tv_sec++;
+        if (pthread_mutex_timedlock(&log_write_mutex, &timeout) == 0) {
+            log_drain_locked();
+            pthread_mutex_unlock(&log_write_mutex);
+        }
+        if (log_fd != STDERR_FILENO)
+            write(log_fd, record, size);
+    }
+
+    write(STDERR_FILENO, record, size);
+    abort();
+}
@@ -0,0 +1,29 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stddef.h>
+
+#define LOG_DROP            0
+#define LOG_BLOCK           1
+
+#define LOG_RING_SIZE       16384
+#define LOG_LINE_MAX        512
+#define LOG_IOV_MAX         64
+#define LOG_INTERVAL_MSEC   20
+
+/*
+ * Each thread appends formatted records to its own ring without locking.
+ * A background flusher collects the rings into writev() calls. Once
+ * more than budget bytes are pending, LOG_DROP discards the record
+ * (counted by log_dropped()) and LOG_BLOCK waits for the flusher.
+ * A record larger than the ring or the budget fails with E2BIG.
+ */
+int log_open(int fd, size_t budget, int policy);
+int log_close(void);
+int log_write(const char *record, size_t size);
+int log_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+int log_flush(void);
+unsigned long log_dropped(void);
+void log_abort(const char *text, const char *file, int line, int code) __attribute__((noreturn));
+
+#endif //LOG_H
@@ -0,0 +1,77 @@
+#ifndef MPSC_H
+#define MPSC_H
+
+#include <stddef.h>
+
+/*
+ * Intrusive multi-producer/single-consumer queue. Nodes are linked
+ * through a pointer field of their own (such as alarm_t.link) whose
+ * offset is fixed when the queue is initialized. Producers push with a
+ * single CAS; the consumer takes the whole queue at once with
+ * mpsc_drain(), which returns the nodes in push order.
+ */
+typedef struct mpsc_tag {
+    void        *head;
+    size_t      offset;
+} mpsc_t;
+
+#define MPSC_INITIALIZER(type, member) {NULL, offsetof(type, member)}
+
+static inline void mpsc_init(mpsc_t *q, size_t offset)
+{
+    q->head = NULL;
+    q->offset = offset;
+}
+
+static inline void **mpsc_link(mpsc_t *q, void *node)
+{
+    return (void **)((char *)node + q->offset);
+}
+
+/* Returns non-zero if the queue was empty, i.e. the consumer may need a wakeup. */
+static inline int mpsc_push(mpsc_t *q, void *node)
+{
+    void *head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+
+    do {
+        *mpsc_link(q, node) = head;
+    } while (!__atomic_compare_exchange_n(&q->head, &head, node, 1,
+        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    return head == NULL;
+}
+
+/* Pushes an already linked chain first..last with a single CAS. */
+static inline int mpsc_push_chain(mpsc_t *q, void *first, void *last)
+{
+    void *head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+
+    do {
+        *mpsc_link(q, last) = head;
+    } while (!__atomic_compare_exchange_n(&q->head, &head, first, 1,
+        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    return head == NULL;
+}
+
+static inline int mpsc_empty(mpsc_t *q)
+{
+    return __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == NULL;
+}
+
+static inline void *mpsc_drain(mpsc_t *q)
+{
+    void *node, *next, *list = NULL;
+
+    node = __atomic_exchange_n(&q->head, NULL, __ATOMIC_ACQUIRE);
+    while (node != NULL) {
+        next = *mpsc_link(q, node);
+        *mpsc_link(q, node) = list;
+        list = node;
+        node = next;
+    }
+
+    return list;
+}
+
+#endif //MPSC_H
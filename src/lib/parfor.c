@@ -0,0 +1,155 @@
+#include "errors.h"
+#include "parfor.h"
+
+typedef struct parfor_partial_tag {
+    double      value;
+} __attribute__((aligned(PARFOR_CACHE_LINE))) parfor_partial_t;
+
+typedef struct parfor_tag {
+    long                begin;
+    long                end;
+    long                grain;
+    long                next;
+    int                 schedule;
+    int                 participants;
+    void                (*fn)(long, long, void *);
+    double              (*reduce)(long, long, void *);
+    double              (*combine)(double, double);
+    double              identity;
+    void                *arg;
+    parfor_partial_t    *partials;
+} parfor_t;
+
+/*
+ * Claims the next chunk, returning 0 once the range is exhausted.
+ */
+static int parfor_claim(parfor_t *loop, int index, int round, long *first, long *last)
+{
+    long start, size, remaining, next;
+
+    switch (loop->schedule) {
+    case PARFOR_STATIC:
+        if (round > 0)
+            return 0;
+        size = (loop->end - loop->begin + loop->participants - 1) / loop->participants;
+        if (size < loop->grain)
+            size = loop->grain;
+        start = loop->begin + size * index;
+        if (start >= loop->end)
+            return 0;
+        *first = start;
+        *last = start + size < loop->end ? start + size : loop->end;
+        return 1;
+
+    case PARFOR_DYNAMIC:
+        start = __atomic_fetch_add(&loop->next, loop->grain, __ATOMIC_RELAXED);
+        if (start >= loop->end)
+            return 0;
+        *first = start;
+        *last = start + loop->grain < loop->end ? start + loop->grain : loop->end;
+        return 1;
+
+    default:
+        start = __atomic_load_n(&loop->next, __ATOMIC_RELAXED);
+        do {
+            remaining = loop->end - start;
+            if (remaining <= 0)
+                return 0;
+            size = remaining / (2 * loop->participants);
+            if (size < loop->grain)
+                size = loop->grain;
+            next = start + size < loop->end ? start + size : loop->end;
+        } while (!__atomic_compare_exchange_n(&loop->next, &start, next, 1,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+        *first = start;
+        *last = next;
+        return 1;
+    }
+}
+
+static int parfor_routine(int index, void *arg, token_t *cancel)
+{
+    parfor_t *loop = (parfor_t *)arg;
+    long first, last;
+    double value = loop->identity;
+    int round;
+
+    for (round = 0; parfor_claim(loop, index, round, &first, &last); round++) {
+        if (loop->reduce != NULL)
+            value = loop->combine(value, loop->reduce(first, last, loop->arg));
+        else
+            loop->fn(first, last, loop->arg);
+    }
+
+    if (loop->reduce != NULL)
+        loop->partials[index].value = value;
+    return 0;
+}
+
+static int parfor_run(team_t *team, parfor_t *loop, long begin, long end, long grain,
+    int schedule)
+{
+    if (end <= begin)
+        return 0;
+    if (grain < 1 || schedule < PARFOR_STATIC || schedule > PARFOR_GUIDED)
+        return EINVAL;
+
+    loop->begin = begin;
+    loop->end = end;
+    loop->grain = grain;
+    loop->next = begin;
+    loop->schedule = schedule;
+    loop->participants = team->size + 1;
+    return team_run(team, loop->participants, parfor_routine, loop);
+}
+
+int parallel_for(team_t *team, long begin, long end, long grain, int schedule,
+    void (*fn)(long, long, void *), void *arg)
+{
+    parfor_t loop;
+
+    if (fn == NULL)
+        return EINVAL;
+
+    loop.fn = fn;
+    loop.reduce = NULL;
+    loop.combine = NULL;
+    loop.identity = 0;
+    loop.arg = arg;
+    loop.partials = NULL;
+    return parfor_run(team, &loop, begin, end, grain, schedule);
+}
+
+int parallel_reduce(team_t *team, long begin, long end, long grain, int schedule,
+    double (*fn)(long, long, void *), double (*combine)(double, double),
+    double identity, void *arg, double *result)
+{
+    parfor_t loop;
+    int index, status;
+
+    if (fn == NULL || combine == NULL)
+        return EINVAL;
+
+    *result = identity;
+    if (end <= begin)
+        return 0;
+
+    if (posix_memalign((void **)&loop.partials, PARFOR_CACHE_LINE,
+        (team->size + 1) * sizeof(parfor_partial_t)) != 0)
+        return ENOMEM;
+
+    loop.fn = NULL;
+    loop.reduce = fn;
+    loop.combine = combine;
+    loop.identity = identity;
+    loop.arg = arg;
+
+    status = parfor_run(team, &loop, begin, end, grain, schedule);
+    if (status == 0) {
+        for (index = 0; index <= team->size; index++)
+            *result = combine(*result, loop.partials[index].value);
+    }
+
+    free(loop.partials);
+    return status;
+}
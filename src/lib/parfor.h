@@ -0,0 +1,25 @@
+#ifndef PARFOR_H
+#define PARFOR_H
+
+#include "team.h"
+
+#define PARFOR_STATIC   0
+#define PARFOR_DYNAMIC  1
+#define PARFOR_GUIDED   2
+
+#define PARFOR_CACHE_LINE   64
+
+/*
+ * Runs fn over [begin, end) on the team's threads and the caller.
+ * PARFOR_STATIC gives each participant one contiguous block,
+ * PARFOR_DYNAMIC hands out grain-sized chunks from an atomic counter,
+ * and PARFOR_GUIDED hands out chunks proportional to the remaining
+ * work, never smaller than grain.
+ */
+int parallel_for(team_t *team, long begin, long end, long grain, int schedule,
+    void (*fn)(long, long, void *), void *arg);
+int parallel_reduce(team_t *team, long begin, long end, long grain, int schedule,
+    double (*fn)(long, long, void *), double (*combine)(double, double),
+    double identity, void *arg, double *result);
+
+#endif //PARFOR_H
@@ -0,0 +1,58 @@
+#include "errors.h"
+#include "perthread.h"
+
+#define CACHELINE_DEFAULT 64
+
+static size_t cacheline_detected = 0;
+
+size_t cacheline_size(void)
+{
+    size_t size = __atomic_load_n(&cacheline_detected, __ATOMIC_RELAXED);
+    FILE *file;
+    long value = 0;
+
+    if (size != 0)
+        return size;
+
+#ifdef _SC_LEVEL1_DCACHE_LINESIZE
+    value = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+#endif
+    if (value <= 0) {
+        file = fopen("/sys/devices/system/cpu/cpu0/cache/index0/coherency_line_size", "r");
+        if (file != NULL) {
+            if (fscanf(file, "%ld", &value) != 1)
+                value = 0;
+            fclose(file);
+        }
+    }
+    if (value <= 0 || (value & (value - 1)) != 0)
+        value = CACHELINE_DEFAULT;
+
+    size = (size_t)value;
+    __atomic_store_n(&cacheline_detected, size, __ATOMIC_RELAXED);
+    return size;
+}
+
+int perthread_init(perthread_t *array, int count, size_t size)
+{
+    size_t line = cacheline_size();
+    int status;
+
+    if (count < 1 || size == 0)
+        return EINVAL;
+
+    array->stride = (size + line - 1) & ~(line - 1);
+    array->count = count;
+    status = posix_memalign((void **)&array->base, line, array->stride * count);
+    if (status != 0)
+        return status;
+
+    memset(array->base, 0, array->stride * count);
+    return 0;
+}
+
+void perthread_destroy(perthread_t *array)
+{
+    free(array->base);
+    array->base = NULL;
+}
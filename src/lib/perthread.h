@@ -0,0 +1,28 @@
+#ifndef PERTHREAD_H
+#define PERTHREAD_H
+
+#include <stddef.h>
+
+/*
+ * An array of per-thread slots, each padded to a whole number of cache
+ * lines and aligned to the line size detected at runtime, so that
+ * threads updating their own slot never share a line.
+ */
+typedef struct perthread_tag {
+    char        *base;
+    size_t      stride;
+    int         count;
+} perthread_t;
+
+#define PERTHREAD(array, type, index) ((type *)perthread_get(array, index))
+
+size_t cacheline_size(void);
+int perthread_init(perthread_t *array, int count, size_t size);
+void perthread_destroy(perthread_t *array);
+
+static inline void *perthread_get(perthread_t *array, int index)
+{
+    return array->base + index * array->stride;
+}
+
+#endif //PERTHREAD_H
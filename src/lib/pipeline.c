@@ -0,0 +1,444 @@
+#include <time.h>
+#include "errors.h"
+#include "futex.h"
+#include "pipeline.h"
+
+#define PIPELINE_EOS ((pipeline_batch_t *)1)
+
+static uint64_t pipeline_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void pipeline_notify(pipeline_worker_t *worker)
+{
+    __atomic_fetch_add(&worker->signal, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&worker->sleeping, __ATOMIC_SEQ_CST))
+        futex_wake(&worker->signal, 1);
+}
+
+/*
+ * Sleeps unless the worker has been notified since it sampled seen.
+ */
+static void pipeline_wait(pipeline_worker_t *worker, int seen)
+{
+    __atomic_store_n(&worker->sleeping, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&worker->signal, __ATOMIC_SEQ_CST) == seen)
+        futex_wait(&worker->signal, seen, NULL);
+    __atomic_store_n(&worker->sleeping, 0, __ATOMIC_RELAXED);
+}
+
+static void pipeline_send(pipeline_worker_t *self, pipeline_batch_t *batch, int target)
+{
+    pipeline_worker_t *next;
+    uint64_t start;
+    int seen;
+
+    next = &self->pipeline->stages[self->stage + 1].workers[target];
+    while (!spsc_push(&next->inputs[self->index], batch)) {
+        seen = __atomic_load_n(&self->signal, __ATOMIC_SEQ_CST);
+        pipeline_notify(next);
+        if (spsc_push(&next->inputs[self->index], batch))
+            break;
+        start = pipeline_now();
+        pipeline_wait(self, seen);
+        self->stats.stalled += pipeline_now() - start;
+    }
+    pipeline_notify(next);
+}
+
+static void pipeline_forward(pipeline_worker_t *self, pipeline_batch_t *batch)
+{
+    pipeline_t *pipeline = self->pipeline;
+    pipeline_stage_t *next;
+
+    if (self->stage + 1 < pipeline->nstages) {
+        next = &pipeline->stages[self->stage + 1];
+        pipeline_send(self, batch, batch->seq % next->parallelism);
+    } else if (mpsc_push(&pipeline->free, batch))
+        pipeline_notify(&pipeline->stages[0].workers[0]);
+}
+
+static void pipeline_process(pipeline_worker_t *self, pipeline_batch_t *batch)
+{
+    pipeline_stage_t *stage = &self->pipeline->stages[self->stage];
+    uint64_t start;
+    int status, error;
+
+    if (__atomic_load_n(&self->pipeline->error, __ATOMIC_RELAXED) == 0) {
+        start = pipeline_now();
+        status = stage->fn(stage->arg, batch->items, &batch->count);
+        self->stats.busy += pipeline_now() - start;
+        self->stats.batches++;
+        self->stats.items += batch->count;
+
+        if (status != 0) {
+            error = 0;
+            __atomic_compare_exchange_n(&self->pipeline->error, &error, status, 0,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        }
+    }
+
+    pipeline_forward(self, batch);
+}
+
+static void pipeline_reorder(pipeline_worker_t *self, pipeline_batch_t *batch)
+{
+    pipeline_batch_t **last;
+
+    for (last = &self->reorder; *last != NULL; last = &(*last)->link)
+        if ((*last)->seq > batch->seq)
+            break;
+    batch->link = *last;
+    *last = batch;
+}
+
+static void pipeline_end(pipeline_worker_t *self)
+{
+    pipeline_t *pipeline = self->pipeline;
+    int target;
+
+    if (self->stage + 1 == pipeline->nstages)
+        return;
+    for (target = 0; target < pipeline->stages[self->stage + 1].parallelism; target++)
+        pipeline_send(self, PIPELINE_EOS, target);
+}
+
+static void *pipeline_source(void *arg)
+{
+    pipeline_worker_t *self = (pipeline_worker_t *)arg;
+    pipeline_t *pipeline = self->pipeline;
+    pipeline_batch_t *free_list = NULL, *batch;
+    unsigned long seq = 0;
+    uint64_t start;
+    int count, seen, error;
+
+    while (__atomic_load_n(&pipeline->error, __ATOMIC_RELAXED) == 0) {
+        while (free_list == NULL) {
+            seen = __atomic_load_n(&self->signal, __ATOMIC_SEQ_CST);
+            free_list = (pipeline_batch_t *)mpsc_drain(&pipeline->free);
+            if (free_list != NULL)
+                break;
+            start = pipeline_now();
+            pipeline_wait(self, seen);
+            self->stats.stalled += pipeline_now() - start;
+        }
+        batch = free_list;
+        free_list = batch->link;
+
+        start = pipeline_now();
+        count = pipeline->source(pipeline->source_arg, batch->items, PIPELINE_BATCH);
+        self->stats.busy += pipeline_now() - start;
+        if (count <= 0) {
+            if (count < 0) {
+                error = 0;
+                __atomic_compare_exchange_n(&pipeline->error, &error, -count, 0,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+            }
+            break;
+        }
+
+        batch->seq = seq++;
+        batch->count = count;
+        self->stats.batches++;
+        self->stats.items += count;
+        pipeline_forward(self, batch);
+    }
+
+    pipeline_end(self);
+    return NULL;
+}
+
+static void *pipeline_worker(void *arg)
+{
+    pipeline_worker_t *self = (pipeline_worker_t *)arg;
+    pipeline_t *pipeline = self->pipeline;
+    pipeline_stage_t *stage = &pipeline->stages[self->stage];
+    pipeline_stage_t *prev = &pipeline->stages[self->stage - 1];
+    pipeline_batch_t *batch;
+    uint64_t start;
+    int input, seen, progress, ended = 0;
+
+    while (1) {
+        seen = __atomic_load_n(&self->signal, __ATOMIC_SEQ_CST);
+        progress = 0;
+
+        for (input = 0; input < prev->parallelism; input++) {
+            while ((batch = (pipeline_batch_t *)spsc_pop(&self->inputs[input])) != NULL) {
+                progress = 1;
+                pipeline_notify(&prev->workers[input]);
+                if (batch == PIPELINE_EOS)
+                    ended++;
+                else if (stage->ordered)
+                    pipeline_reorder(self, batch);
+                else
+                    pipeline_process(self, batch);
+            }
+        }
+
+        while (self->reorder != NULL && self->reorder->seq == self->expected) {
+            batch = self->reorder;
+            self->reorder = batch->link;
+            self->expected += stage->parallelism;
+            pipeline_process(self, batch);
+        }
+
+        if (ended == prev->parallelism && self->reorder == NULL)
+            break;
+
+        if (!progress) {
+            start = pipeline_now();
+            pipeline_wait(self, seen);
+            self->stats.idle += pipeline_now() - start;
+        }
+    }
+
+    pipeline_end(self);
+    return NULL;
+}
+
+int pipeline_init(pipeline_t *pipeline, int (*source)(void *, void **, int), void *arg)
+{
+    pipeline_stage_t *stage = &pipeline->stages[0];
+
+    if (source == NULL)
+        return EINVAL;
+
+    pipeline->batches = (pipeline_batch_t *)malloc(PIPELINE_POOL * sizeof(pipeline_batch_t));
+    if (pipeline->batches == NULL)
+        return ENOMEM;
+
+    if (posix_memalign((void **)&stage->workers, SPSC_CACHE_LINE, sizeof(pipeline_worker_t)) != 0) {
+        free(pipeline->batches);
+        return ENOMEM;
+    }
+
+    memset(stage->workers, 0, sizeof(pipeline_worker_t));
+    stage->workers[0].pipeline = pipeline;
+    stage->name = "source";
+    stage->fn = NULL;
+    stage->arg = arg;
+    stage->parallelism = 1;
+    stage->ordered = PIPELINE_ORDERED;
+
+    pipeline->nstages = 1;
+    pipeline->source = source;
+    pipeline->source_arg = arg;
+    pipeline->error = 0;
+    pipeline->elapsed = 0;
+    pipeline->valid = PIPELINE_VALID;
+    return 0;
+}
+
+int pipeline_destroy(pipeline_t *pipeline)
+{
+    pipeline_stage_t *stage;
+    int index, worker, input;
+
+    if (pipeline->valid != PIPELINE_VALID)
+        return EINVAL;
+
+    pipeline->valid = 0;
+    for (index = pipeline->nstages - 1; index >= 0; index--) {
+        stage = &pipeline->stages[index];
+        for (worker = 0; index > 0 && worker < stage->parallelism; worker++) {
+            for (input = 0; input < pipeline->stages[index - 1].parallelism; input++)
+                spsc_destroy(&stage->workers[worker].inputs[input]);
+            free(stage->workers[worker].inputs);
+        }
+        free(stage->workers);
+    }
+
+    free(pipeline->batches);
+    return 0;
+}
+
+int pipeline_stage(pipeline_t *pipeline, const char *name, int parallelism, int ordered,
+    int (*fn)(void *, void **, int *), void *arg)
+{
+    pipeline_stage_t *stage, *prev;
+    pipeline_worker_t *worker;
+    int index, input, status;
+
+    if (pipeline->valid != PIPELINE_VALID || fn == NULL
+        || parallelism < 1 || parallelism > PIPELINE_MAX_WORKERS)
+        return EINVAL;
+    if (pipeline->nstages == PIPELINE_MAX_STAGES)
+        return EAGAIN;
+
+    prev = &pipeline->stages[pipeline->nstages - 1];
+    stage = &pipeline->stages[pipeline->nstages];
+
+    if (posix_memalign((void **)&stage->workers, SPSC_CACHE_LINE,
+        parallelism * sizeof(pipeline_worker_t)) != 0)
+        return ENOMEM;
+    memset(stage->workers, 0, parallelism * sizeof(pipeline_worker_t));
+
+    for (index = 0; index < parallelism; index++) {
+        worker = &stage->workers[index];
+        worker->pipeline = pipeline;
+        worker->stage = pipeline->nstages;
+        worker->index = index;
+        worker->expected = index;
+
+        status = posix_memalign((void **)&worker->inputs, SPSC_CACHE_LINE,
+            prev->parallelism * sizeof(spsc_t));
+        if (status != 0)
+            goto unwind;
+        for (input = 0; input < prev->parallelism; input++) {
+            status = spsc_init(&worker->inputs[input], PIPELINE_RING);
+            if (status != 0) {
+                while (--input >= 0)
+                    spsc_destroy(&worker->inputs[input]);
+                free(worker->inputs);
+                goto unwind;
+            }
+        }
+    }
+
+    stage->name = name;
+    stage->fn = fn;
+    stage->arg = arg;
+    stage->parallelism = parallelism;
+    stage->ordered = ordered;
+    pipeline->nstages++;
+    return 0;
+
+unwind:
+    while (--index >= 0) {
+        for (input = 0; input < prev->parallelism; input++)
+            spsc_destroy(&stage->workers[index].inputs[input]);
+        free(stage->workers[index].inputs);
+    }
+    free(stage->workers);
+    return status;
+}
+
+/*
+ * Puts every batch back in the pool and rewinds each worker's ordering
+ * and counters. The last run's source may have ended holding part of the
+ * pool privately, and its ordered stages expect the old sequence.
+ */
+static void pipeline_reset(pipeline_t *pipeline)
+{
+    pipeline_worker_t *worker;
+    int index, count;
+
+    mpsc_init(&pipeline->free, offsetof(pipeline_batch_t, link));
+    for (count = 0; count < PIPELINE_POOL; count++)
+        mpsc_push(&pipeline->free, &pipeline->batches[count]);
+
+    for (index = 0; index < pipeline->nstages; index++) {
+        for (count = 0; count < pipeline->stages[index].parallelism; count++) {
+            worker = &pipeline->stages[index].workers[count];
+            worker->reorder = NULL;
+            worker->expected = count;
+            memset(&worker->stats, 0, sizeof(worker->stats));
+        }
+    }
+
+    pipeline->error = 0;
+}
+
+/*
+ * Threads are started from the last stage back, so when creating worker
+ * (index, failed) fails, the stages after index are all running and so
+ * are the first failed workers of stage index. Send those workers the
+ * end of stream they expect from the threads that never started, then
+ * join them.
+ */
+static void pipeline_unwind(pipeline_t *pipeline, int index, int failed)
+{
+    pipeline_stage_t *stage = &pipeline->stages[index];
+    pipeline_worker_t *worker;
+    int count, input, target;
+
+    if (index + 1 < pipeline->nstages) {
+        for (count = failed; count < stage->parallelism; count++) {
+            for (target = 0; target < pipeline->stages[index + 1].parallelism; target++) {
+                worker = &pipeline->stages[index + 1].workers[target];
+                spsc_push(&worker->inputs[count], PIPELINE_EOS);
+                pipeline_notify(worker);
+            }
+        }
+    }
+
+    for (count = 0; count < failed; count++) {
+        worker = &stage->workers[count];
+        for (input = 0; input < pipeline->stages[index - 1].parallelism; input++)
+            spsc_push(&worker->inputs[input], PIPELINE_EOS);
+        pipeline_notify(worker);
+    }
+
+    for (count = 0; count < failed; count++)
+        pthread_join(stage->workers[count].thread, NULL);
+    for (index++; index < pipeline->nstages; index++) {
+        stage = &pipeline->stages[index];
+        for (count = 0; count < stage->parallelism; count++)
+            pthread_join(stage->workers[count].thread, NULL);
+    }
+}
+
+int pipeline_run(pipeline_t *pipeline)
+{
+    pipeline_stage_t *stage;
+    uint64_t start;
+    int index, worker, status;
+
+    if (pipeline->valid != PIPELINE_VALID || pipeline->nstages < 2)
+        return EINVAL;
+
+    pipeline_reset(pipeline);
+    start = pipeline_now();
+    for (index = pipeline->nstages - 1; index >= 0; index--) {
+        stage = &pipeline->stages[index];
+        for (worker = 0; worker < stage->parallelism; worker++) {
+            status = pthread_create(&stage->workers[worker].thread, NULL,
+                index == 0 ? pipeline_source : pipeline_worker,
+                (void *)&stage->workers[worker]);
+            if (status != 0) {
+                pipeline_unwind(pipeline, index, worker);
+                return status;
+            }
+        }
+    }
+
+    for (index = 0; index < pipeline->nstages; index++) {
+        stage = &pipeline->stages[index];
+        for (worker = 0; worker < stage->parallelism; worker++) {
+            status = pthread_join(stage->workers[worker].thread, NULL);
+            if (status != 0)
+                return status;
+        }
+    }
+    pipeline->elapsed = pipeline_now() - start;
+
+    return pipeline->error;
+}
+
+int pipeline_stats(pipeline_t *pipeline, int stage, pipeline_stats_t *stats)
+{
+    pipeline_worker_t *worker;
+    int index;
+
+    if (pipeline->valid != PIPELINE_VALID || stage < 0 || stage >= pipeline->nstages)
+        return EINVAL;
+
+    memset(stats, 0, sizeof(pipeline_stats_t));
+    stats->parallelism = pipeline->stages[stage].parallelism;
+    for (index = 0; index < stats->parallelism; index++) {
+        worker = &pipeline->stages[stage].workers[index];
+        stats->batches += worker->stats.batches;
+        stats->items += worker->stats.items;
+        stats->busy += worker->stats.busy;
+        stats->idle += worker->stats.idle;
+        stats->stalled += worker->stats.stalled;
+    }
+
+    if (pipeline->elapsed > 0)
+        stats->utilization = (double)stats->busy / ((double)pipeline->elapsed * stats->parallelism);
+    return 0;
+}
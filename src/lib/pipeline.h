@@ -0,0 +1,86 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "mpsc.h"
+#include "spsc.h"
+
+#define PIPELINE_BATCH          32
+#define PIPELINE_RING           16
+#define PIPELINE_POOL           256
+#define PIPELINE_MAX_STAGES     8
+#define PIPELINE_MAX_WORKERS    16
+
+#define PIPELINE_UNORDERED      0
+#define PIPELINE_ORDERED        1
+
+typedef struct pipeline_batch_tag {
+    struct pipeline_batch_tag   *link;
+    unsigned long               seq;
+    int                         count;
+    void                        *items[PIPELINE_BATCH];
+} pipeline_batch_t;
+
+typedef struct pipeline_stats_tag {
+    int             parallelism;
+    unsigned long   batches;
+    unsigned long   items;
+    uint64_t        busy;
+    uint64_t        idle;
+    uint64_t        stalled;
+    double          utilization;
+} pipeline_stats_t;
+
+typedef struct pipeline_worker_tag {
+    int                         signal;
+    int                         sleeping;
+    char                        pad[SPSC_CACHE_LINE - 2 * sizeof(int)];
+    struct pipeline_tag         *pipeline;
+    pthread_t                   thread;
+    spsc_t                      *inputs;
+    pipeline_batch_t            *reorder;
+    unsigned long               expected;
+    int                         stage;
+    int                         index;
+    pipeline_stats_t            stats;
+} __attribute__((aligned(SPSC_CACHE_LINE))) pipeline_worker_t;
+
+typedef struct pipeline_stage_tag {
+    const char          *name;
+    int                 (*fn)(void *, void **, int *);
+    void                *arg;
+    int                 parallelism;
+    int                 ordered;
+    pipeline_worker_t   *workers;
+} pipeline_stage_t;
+
+/*
+ * Stage 0 is the source; each added stage transforms a batch of items
+ * in place and may shrink the count to filter. Batches are dealt to a
+ * stage's workers by sequence number over per-pair SPSC rings, and an
+ * ordered stage processes its share in sequence order. A pipeline can be
+ * run again once pipeline_run() has returned; stats cover the last run.
+ */
+typedef struct pipeline_tag {
+    pipeline_stage_t    stages[PIPELINE_MAX_STAGES];
+    int                 nstages;
+    int                 (*source)(void *, void **, int);
+    void                *source_arg;
+    mpsc_t              free;
+    pipeline_batch_t    *batches;
+    int                 error;
+    int                 valid;
+    uint64_t            elapsed;
+} pipeline_t;
+
+#define PIPELINE_VALID 0x919e11
+
+int pipeline_init(pipeline_t *pipeline, int (*source)(void *, void **, int), void *arg);
+int pipeline_destroy(pipeline_t *pipeline);
+int pipeline_stage(pipeline_t *pipeline, const char *name, int parallelism, int ordered,
+    int (*fn)(void *, void **, int *), void *arg);
+int pipeline_run(pipeline_t *pipeline);
+int pipeline_stats(pipeline_t *pipeline, int stage, pipeline_stats_t *stats);
+
+#endif //PIPELINE_H
@@ -0,0 +1,185 @@
+#define _GNU_SOURCE
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include "errors.h"
+#include "procpool.h"
+
+extern char **environ;
+
+static void procpool_child(procpool_t *pool)
+{
+    char job[PROCPOOL_JOB_SIZE];
+    char done = 1;
+    ssize_t bytes;
+
+    close(pool->job_fd[1]);
+    close(pool->done_fd[0]);
+
+    while (1) {
+        bytes = read(pool->job_fd[0], job, sizeof(job));
+        if (bytes == 0)
+            _exit(0);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes != sizeof(job))
+            _exit(1);
+
+        pool->handler(job);
+        fflush(NULL);
+
+        while (write(pool->done_fd[1], &done, 1) < 0)
+            if (errno != EINTR)
+                _exit(1);
+    }
+}
+
+int procpool_init(procpool_t *pool, int workers, void (*handler)(void *))
+{
+    pid_t pid;
+    int status, count;
+
+    if (workers < 1 || handler == NULL)
+        return EINVAL;
+
+    pool->workers = (pid_t *)malloc(workers * sizeof(pid_t));
+    if (pool->workers == NULL)
+        return ENOMEM;
+
+    /*
+     * Close-on-exec keeps the pipe ends out of procpool_spawn() children;
+     * a spawned child holding the job pipe's write end would stop the
+     * workers from ever seeing EOF in procpool_destroy().
+     */
+    if (pipe2(pool->job_fd, O_CLOEXEC) == -1) {
+        status = errno;
+        free(pool->workers);
+        return status;
+    }
+
+    if (pipe2(pool->done_fd, O_CLOEXEC) == -1) {
+        status = errno;
+        close(pool->job_fd[0]);
+        close(pool->job_fd[1]);
+        free(pool->workers);
+        return status;
+    }
+
+    pool->parallelism = workers;
+    pool->pending = 0;
+    pool->handler = handler;
+
+    fflush(NULL);
+    for (count = 0; count < workers; count++) {
+        pid = fork();
+        if (pid == (pid_t)-1) {
+            status = errno;
+            close(pool->job_fd[0]);
+            close(pool->job_fd[1]);
+            close(pool->done_fd[0]);
+            close(pool->done_fd[1]);
+            while (--count >= 0)
+                waitpid(pool->workers[count], NULL, 0);
+            free(pool->workers);
+            return status;
+        }
+
+        if (pid == (pid_t)0)
+            procpool_child(pool);
+
+        pool->workers[count] = pid;
+    }
+
+    close(pool->job_fd[0]);
+    close(pool->done_fd[1]);
+    fcntl(pool->done_fd[0], F_SETFL, fcntl(pool->done_fd[0], F_GETFL) | O_NONBLOCK);
+
+    pool->valid = PROCPOOL_VALID;
+    return 0;
+}
+
+int procpool_destroy(procpool_t *pool)
+{
+    int status, count;
+
+    if (pool->valid != PROCPOOL_VALID)
+        return EINVAL;
+
+    pool->valid = 0;
+    close(pool->job_fd[1]);
+
+    status = 0;
+    for (count = 0; count < pool->parallelism; count++) {
+        while (waitpid(pool->workers[count], NULL, 0) == (pid_t)-1) {
+            if (errno != EINTR) {
+                status = errno;
+                break;
+            }
+        }
+    }
+
+    close(pool->done_fd[0]);
+    free(pool->workers);
+    return status;
+}
+
+int procpool_submit(procpool_t *pool, const void *job, size_t size)
+{
+    char record[PROCPOOL_JOB_SIZE];
+    ssize_t bytes;
+
+    if (pool->valid != PROCPOOL_VALID || size > sizeof(record))
+        return EINVAL;
+
+    memset(record, 0, sizeof(record));
+    memcpy(record, job, size);
+
+    while ((bytes = write(pool->job_fd[1], record, sizeof(record))) < 0)
+        if (errno != EINTR)
+            return errno;
+
+    if (bytes != sizeof(record))
+        return EIO;
+
+    pool->pending++;
+    return 0;
+}
+
+int procpool_reap(procpool_t *pool, int block, int *done)
+{
+    struct pollfd pfd;
+    char buffer[256];
+    ssize_t bytes;
+    int count = 0;
+
+    if (pool->valid != PROCPOOL_VALID)
+        return EINVAL;
+
+    if (block && pool->pending > 0) {
+        pfd.fd = pool->done_fd[0];
+        pfd.events = POLLIN;
+        while (poll(&pfd, 1, -1) < 0)
+            if (errno != EINTR)
+                return errno;
+    }
+
+    while ((bytes = read(pool->done_fd[0], buffer, sizeof(buffer))) > 0)
+        count += bytes;
+
+    if (bytes == 0 && count == 0 && pool->pending > 0)
+        return EPIPE;
+
+    if (bytes < 0 && errno != EAGAIN && errno != EINTR)
+        return errno;
+
+    pool->pending -= count;
+    if (done != NULL)
+        *done = count;
+    return 0;
+}
+
+int procpool_spawn(pid_t *pid, char *const argv[])
+{
+    return posix_spawnp(pid, argv[0], NULL, NULL, argv, environ);
+}
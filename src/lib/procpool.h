@@ -0,0 +1,26 @@
+#ifndef PROCPOOL_H
+#define PROCPOOL_H
+
+#include <sys/types.h>
+
+#define PROCPOOL_JOB_SIZE 128
+
+typedef struct procpool_tag {
+    pid_t       *workers;
+    int         job_fd[2];
+    int         done_fd[2];
+    int         valid;
+    int         parallelism;
+    int         pending;
+    void        (*handler)(void *);
+} procpool_t;
+
+#define PROCPOOL_VALID 0x9f0c2a
+
+int procpool_init(procpool_t *pool, int workers, void (*handler)(void *));
+int procpool_destroy(procpool_t *pool);
+int procpool_submit(procpool_t *pool, const void *job, size_t size);
+int procpool_reap(procpool_t *pool, int block, int *done);
+int procpool_spawn(pid_t *pid, char *const argv[]);
+
+#endif //PROCPOOL_H
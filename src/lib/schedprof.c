@@ -0,0 +1,212 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "errors.h"
+#include "schedprof.h"
+
+typedef struct schedprof_start_tag {
+    void        *(*start)(void *);
+    void        *arg;
+    int         policy;
+} schedprof_start_t;
+
+static pthread_once_t schedprof_once = PTHREAD_ONCE_INIT;
+static int schedprof_locked = 0;
+
+/*
+ * MCL_FUTURE makes later mappings (thread stacks included) fail once
+ * RLIMIT_MEMLOCK is reached, so only ask for it when the limit cannot
+ * be hit.
+ */
+static void schedprof_lock_memory(void)
+{
+    struct rlimit limit;
+    int flags = MCL_CURRENT;
+
+    if (geteuid() == 0 || (getrlimit(RLIMIT_MEMLOCK, &limit) == 0
+        && limit.rlim_cur == RLIM_INFINITY))
+        flags |= MCL_FUTURE;
+    schedprof_locked = mlockall(flags) == 0;
+}
+
+static int schedprof_cpu(int cpu)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return cpus > 0 ? cpu % cpus : 0;
+}
+
+static void *schedprof_thread(void *arg)
+{
+    schedprof_start_t start = *(schedprof_start_t *)arg;
+    struct sched_param param;
+
+    free(arg);
+    param.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), start.policy, &param);
+    return start.start(start.arg);
+}
+
+static int schedprof_policy(int profile)
+{
+    switch (profile) {
+    case SCHEDPROF_LATENCY:
+        return SCHED_FIFO;
+    case SCHEDPROF_THROUGHPUT:
+        return SCHED_BATCH;
+    case SCHEDPROF_BACKGROUND:
+        return SCHED_IDLE;
+    default:
+        return SCHED_OTHER;
+    }
+}
+
+static int schedprof_latency_attr(pthread_attr_t *attr, int cpu, int *degraded)
+{
+    struct sched_param param;
+    cpu_set_t cpus;
+    int status;
+
+    pthread_once(&schedprof_once, schedprof_lock_memory);
+    if (!schedprof_locked)
+        *degraded = 1;
+
+    if (cpu != SCHEDPROF_ANY_CPU) {
+        CPU_ZERO(&cpus);
+        CPU_SET(schedprof_cpu(cpu), &cpus);
+        status = pthread_attr_setaffinity_np(attr, sizeof(cpus), &cpus);
+        if (status != 0)
+            return status;
+    }
+
+    param.sched_priority = (sched_get_priority_min(SCHED_FIFO)
+        + sched_get_priority_max(SCHED_FIFO)) / 2;
+    status = pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED);
+    if (status == 0)
+        status = pthread_attr_setschedpolicy(attr, SCHED_FIFO);
+    if (status == 0)
+        status = pthread_attr_setschedparam(attr, &param);
+    return status;
+}
+
+int schedprof_create(pthread_t *thread, const pthread_attr_t *attr, int profile,
+    int cpu, void *(*start)(void *), void *arg, int *degraded)
+{
+    pthread_attr_t profile_attr;
+    schedprof_start_t *trampoline;
+    size_t stacksize;
+    int detach, status, lowered = 0;
+
+    if (profile < SCHEDPROF_DEFAULT || profile > SCHEDPROF_BACKGROUND)
+        return EINVAL;
+    if (degraded != NULL)
+        *degraded = 0;
+    if (profile == SCHEDPROF_DEFAULT)
+        return pthread_create(thread, attr, start, arg);
+
+    status = pthread_attr_init(&profile_attr);
+    if (status != 0)
+        return status;
+
+    if (attr != NULL) {
+        if (pthread_attr_getdetachstate(attr, &detach) == 0)
+            pthread_attr_setdetachstate(&profile_attr, detach);
+        if (pthread_attr_getstacksize(attr, &stacksize) == 0)
+            pthread_attr_setstacksize(&profile_attr, stacksize);
+    }
+
+    if (profile == SCHEDPROF_LATENCY) {
+        status = schedprof_latency_attr(&profile_attr, cpu, &lowered);
+        if (status == 0) {
+            status = pthread_create(thread, &profile_attr, start, arg);
+            if (status == EPERM) {
+                lowered = 1;
+                pthread_attr_setinheritsched(&profile_attr, PTHREAD_INHERIT_SCHED);
+                status = pthread_create(thread, &profile_attr, start, arg);
+            }
+        }
+    } else {
+        trampoline = (schedprof_start_t *)malloc(sizeof(schedprof_start_t));
+        if (trampoline == NULL)
+            status = ENOMEM;
+        else {
+            trampoline->start = start;
+            trampoline->arg = arg;
+            trampoline->policy = schedprof_policy(profile);
+            status = pthread_create(thread, &profile_attr, schedprof_thread, trampoline);
+            if (status != 0)
+                free(trampoline);
+        }
+    }
+
+    pthread_attr_destroy(&profile_attr);
+    if (status == 0 && degraded != NULL)
+        *degraded = lowered;
+    return status;
+}
+
+int schedprof_apply_self(int profile, int cpu, int *degraded)
+{
+    struct sched_param param;
+    cpu_set_t cpus;
+    int policy, status;
+
+    if (profile < SCHEDPROF_DEFAULT || profile > SCHEDPROF_BACKGROUND)
+        return EINVAL;
+    if (degraded != NULL)
+        *degraded = 0;
+
+    policy = schedprof_policy(profile);
+    param.sched_priority = 0;
+    if (profile == SCHEDPROF_LATENCY) {
+        pthread_once(&schedprof_once, schedprof_lock_memory);
+        if (!schedprof_locked && degraded != NULL)
+            *degraded = 1;
+
+        if (cpu != SCHEDPROF_ANY_CPU) {
+            CPU_ZERO(&cpus);
+            CPU_SET(schedprof_cpu(cpu), &cpus);
+            status = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+            if (status != 0)
+                return status;
+        }
+        param.sched_priority = (sched_get_priority_min(SCHED_FIFO)
+            + sched_get_priority_max(SCHED_FIFO)) / 2;
+    }
+
+    status = pthread_setschedparam(pthread_self(), policy, &param);
+    if (status == EPERM && profile == SCHEDPROF_LATENCY) {
+        if (degraded != NULL)
+            *degraded = 1;
+        return 0;
+    }
+    return status;
+}
+
+const char *schedprof_name(int profile)
+{
+    static const char *names[] = {"default", "latency", "throughput", "background"};
+
+    if (profile < SCHEDPROF_DEFAULT || profile > SCHEDPROF_BACKGROUND)
+        return "unknown";
+    return names[profile];
+}
+
+const char *schedprof_policy_name(int policy)
+{
+    switch (policy) {
+    case SCHED_OTHER:
+        return "OTHER";
+    case SCHED_FIFO:
+        return "FIFO";
+    case SCHED_RR:
+        return "RR";
+    case SCHED_BATCH:
+        return "BATCH";
+    case SCHED_IDLE:
+        return "IDLE";
+    default:
+        return "unknown";
+    }
+}
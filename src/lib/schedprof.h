@@ -0,0 +1,36 @@
+#ifndef SCHEDPROF_H
+#define SCHEDPROF_H
+
+#include <pthread.h>
+
+#define SCHEDPROF_DEFAULT       0
+#define SCHEDPROF_LATENCY       1
+#define SCHEDPROF_THROUGHPUT    2
+#define SCHEDPROF_BACKGROUND    3
+
+#define SCHEDPROF_ANY_CPU       -1
+
+/*
+ * Named scheduling profiles applied when a thread is created:
+ *
+ *   LATENCY     SCHED_FIFO at the middle of its range, pinned to cpu
+ *               (modulo the online CPUs) unless SCHEDPROF_ANY_CPU, with
+ *               the process memory locked.
+ *   THROUGHPUT  SCHED_BATCH, so the scheduler favours long slices.
+ *   BACKGROUND  SCHED_IDLE, runs only when nothing else wants the CPU.
+ *
+ * Only LATENCY pins; other profiles ignore cpu. attr, when not NULL,
+ * supplies the detach state and stack size. Real-time policy and
+ * affinity go through the thread attributes. BATCH and IDLE are not
+ * accepted by pthread_attr_setschedpolicy(), so the new thread sets
+ * them before it calls start. Without the privilege for SCHED_FIFO or
+ * mlockall() the thread is still created, at the inherited policy, and
+ * *degraded (when not NULL) is set.
+ */
+int schedprof_create(pthread_t *thread, const pthread_attr_t *attr, int profile,
+    int cpu, void *(*start)(void *), void *arg, int *degraded);
+int schedprof_apply_self(int profile, int cpu, int *degraded);
+const char *schedprof_name(int profile);
+const char *schedprof_policy_name(int policy);
+
+#endif //SCHEDPROF_H
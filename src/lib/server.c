@@ -0,0 +1,201 @@
+#include "errors.h"
+#include "futex.h"
+#include "server.h"
+
+static void server_complete(server_request_t *request)
+{
+    server_mailbox_t *mailbox = request->mailbox;
+
+    if (mailbox != NULL) {
+        if (mpsc_push(&mailbox->done, request))
+            eventcount_notify(&mailbox->ready);
+    } else if (__atomic_exchange_n(&request->state, SERVER_DONE, __ATOMIC_RELEASE) == SERVER_WAITING)
+        futex_wake(&request->state, 1);
+}
+
+static void *server_thread(void *arg)
+{
+    server_t *server = (server_t *)arg;
+    server_request_t *request, *next;
+    int key;
+
+    while (1) {
+        request = (server_request_t *)mpsc_drain(&server->inbox);
+        if (request == NULL) {
+            key = eventcount_prepare(&server->ready);
+            request = (server_request_t *)mpsc_drain(&server->inbox);
+            if (request != NULL)
+                eventcount_cancel(&server->ready);
+            else if (__atomic_load_n(&server->quit, __ATOMIC_ACQUIRE)) {
+                eventcount_cancel(&server->ready);
+                break;
+            } else {
+                eventcount_wait(&server->ready, key, NULL);
+                continue;
+            }
+        }
+
+        for (; request != NULL; request = next) {
+            next = request->link;
+            request->status = server->handler(server->arg, request);
+            server_complete(request);
+        }
+    }
+
+    return NULL;
+}
+
+int server_init(server_t *server, int threads,
+    int (*handler)(void *, server_request_t *), void *arg)
+{
+    int status, count;
+
+    if (threads < 1 || handler == NULL)
+        return EINVAL;
+
+    server->threads = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    if (server->threads == NULL)
+        return ENOMEM;
+
+    mpsc_init(&server->inbox, offsetof(server_request_t, link));
+    eventcount_init(&server->ready, EVENTCOUNT_FUTEX);
+    server->handler = handler;
+    server->arg = arg;
+    server->quit = 0;
+
+    for (count = 0; count < threads; count++) {
+        status = pthread_create(&server->threads[count], NULL, server_thread, (void *)server);
+        if (status != 0) {
+            server->parallelism = count;
+            server->valid = SERVER_VALID;
+            server_destroy(server);
+            return status;
+        }
+    }
+
+    server->parallelism = threads;
+    server->valid = SERVER_VALID;
+    return 0;
+}
+
+int server_destroy(server_t *server)
+{
+    int status, count;
+
+    if (server->valid != SERVER_VALID)
+        return EINVAL;
+
+    server->valid = 0;
+    __atomic_store_n(&server->quit, 1, __ATOMIC_RELEASE);
+    eventcount_notify_all(&server->ready);
+
+    for (count = 0; count < server->parallelism; count++) {
+        status = pthread_join(server->threads[count], NULL);
+        if (status != 0)
+            return status;
+    }
+
+    free(server->threads);
+    return 0;
+}
+
+void server_request_init(server_request_t *request, int op, void *arg)
+{
+    request->op = op;
+    request->arg = arg;
+    request->result = 0;
+    request->status = 0;
+    request->state = SERVER_PENDING;
+    request->mailbox = NULL;
+}
+
+int server_send(server_t *server, server_request_t *request, server_mailbox_t *mailbox)
+{
+    if (server->valid != SERVER_VALID)
+        return EINVAL;
+
+    request->state = SERVER_PENDING;
+    request->mailbox = mailbox;
+    if (mpsc_push(&server->inbox, request))
+        eventcount_notify(&server->ready);
+    return 0;
+}
+
+/*
+ * Queues the requests with a single CAS on the inbox.
+ */
+int server_send_batch(server_t *server, server_request_t **requests, int count,
+    server_mailbox_t *mailbox)
+{
+    int index;
+
+    if (server->valid != SERVER_VALID)
+        return EINVAL;
+    if (count <= 0)
+        return 0;
+
+    for (index = 0; index < count; index++) {
+        requests[index]->state = SERVER_PENDING;
+        requests[index]->mailbox = mailbox;
+        requests[index]->link = (index > 0) ? requests[index - 1] : NULL;
+    }
+
+    if (mpsc_push_chain(&server->inbox, requests[count - 1], requests[0]))
+        eventcount_notify(&server->ready);
+    return 0;
+}
+
+int server_wait(server_request_t *request)
+{
+    int state = SERVER_PENDING;
+
+    if (__atomic_compare_exchange_n(&request->state, &state, SERVER_WAITING, 0,
+        __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE) || state == SERVER_WAITING) {
+        while (__atomic_load_n(&request->state, __ATOMIC_ACQUIRE) != SERVER_DONE)
+            futex_wait(&request->state, SERVER_WAITING, NULL);
+    }
+
+    return request->status;
+}
+
+int server_call(server_t *server, int op, void *arg, long *result)
+{
+    server_request_t request;
+    int status;
+
+    server_request_init(&request, op, arg);
+    status = server_send(server, &request, NULL);
+    if (status != 0)
+        return status;
+
+    status = server_wait(&request);
+    *result = request.result;
+    return status;
+}
+
+void server_mailbox_init(server_mailbox_t *mailbox)
+{
+    mpsc_init(&mailbox->done, offsetof(server_request_t, link));
+    eventcount_init(&mailbox->ready, EVENTCOUNT_FUTEX);
+}
+
+/*
+ * Returns every completed request in completion order, linked through
+ * request->link, or NULL if none is ready and block is zero.
+ */
+server_request_t *server_mailbox_take(server_mailbox_t *mailbox, int block)
+{
+    server_request_t *done;
+    int key;
+
+    done = (server_request_t *)mpsc_drain(&mailbox->done);
+    while (done == NULL && block) {
+        key = eventcount_prepare(&mailbox->ready);
+        done = (server_request_t *)mpsc_drain(&mailbox->done);
+        if (done != NULL)
+            eventcount_cancel(&mailbox->ready);
+        else
+            eventcount_wait(&mailbox->ready, key, NULL);
+    }
+    return done;
+}
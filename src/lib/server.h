@@ -0,0 +1,62 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <pthread.h>
+#include "eventcount.h"
+#include "mpsc.h"
+
+#define SERVER_CACHE_LINE   64
+
+#define SERVER_PENDING      0
+#define SERVER_WAITING      1
+#define SERVER_DONE         2
+
+typedef struct server_request_tag {
+    struct server_request_tag   *link;
+    int                         op;
+    void                        *arg;
+    long                        result;
+    int                         status;
+    int                         state;
+    struct server_mailbox_tag   *mailbox;
+} server_request_t;
+
+typedef struct server_mailbox_tag {
+    mpsc_t          done;
+    eventcount_t    ready;
+} __attribute__((aligned(SERVER_CACHE_LINE))) server_mailbox_t;
+
+/*
+ * Server threads take requests from a lock-free inbox and call the
+ * handler, which fills in request->result and returns the status.
+ * A request sent without a mailbox is its own future, waited on with
+ * server_wait(); otherwise the completed request is queued to the
+ * mailbox, so a client can keep many requests in flight.
+ */
+typedef struct server_tag {
+    mpsc_t      inbox;
+    eventcount_t ready;
+    char        pad[SERVER_CACHE_LINE - sizeof(mpsc_t) - sizeof(eventcount_t)];
+    pthread_t   *threads;
+    int         (*handler)(void *, server_request_t *);
+    void        *arg;
+    int         parallelism;
+    int         quit;
+    int         valid;
+} __attribute__((aligned(SERVER_CACHE_LINE))) server_t;
+
+#define SERVER_VALID 0x5e7e7
+
+int server_init(server_t *server, int threads,
+    int (*handler)(void *, server_request_t *), void *arg);
+int server_destroy(server_t *server);
+void server_request_init(server_request_t *request, int op, void *arg);
+int server_send(server_t *server, server_request_t *request, server_mailbox_t *mailbox);
+int server_send_batch(server_t *server, server_request_t **requests, int count,
+    server_mailbox_t *mailbox);
+int server_wait(server_request_t *request);
+int server_call(server_t *server, int op, void *arg, long *result);
+void server_mailbox_init(server_mailbox_t *mailbox);
+server_request_t *server_mailbox_take(server_mailbox_t *mailbox, int block);
+
+#endif //SERVER_H
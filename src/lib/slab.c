@@ -0,0 +1,402 @@
+#include "errors.h"
+#include "forksafe.h"
+#include "slab.h"
+
+typedef struct slab_batch_tag {
+    slab_cache_t    *owner;
+    slab_header_t   *first, *last;
+    int             count;
+} slab_batch_t;
+
+/*
+ * Ids are reused once a slab is destroyed, so each thread remembers the
+ * generation its cache and batch for an id belong to and drops them when
+ * a newer slab holds the id.
+ */
+typedef struct slab_thread_tag {
+    int             registered;
+    slab_cache_t    *caches[SLAB_MAX];
+    slab_batch_t    batches[SLAB_MAX];
+    unsigned long   generations[SLAB_MAX];
+} slab_thread_t;
+
+static pthread_mutex_t slab_table_mutex = PTHREAD_MUTEX_INITIALIZER;
+static slab_t *slab_table[SLAB_MAX];
+static unsigned long long slab_ids = 0;
+static unsigned long slab_generation = 0;
+
+static pthread_once_t slab_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slab_exit_key;
+static __thread slab_thread_t slab_self;
+
+static pthread_once_t slab_fork_once = PTHREAD_ONCE_INIT;
+static forksafe_t slab_fork;
+static int slab_fork_status = 0;
+
+static void slab_flush_batch(slab_batch_t *batch)
+{
+    if (batch->count == 0)
+        return;
+
+    mpsc_push_chain(&batch->owner->remote, batch->first, batch->last);
+    batch->owner = NULL;
+    batch->first = batch->last = NULL;
+    batch->count = 0;
+}
+
+static slab_cache_t *slab_local(slab_t *slab)
+{
+    if (slab_self.generations[slab->id] != slab->generation) {
+        slab_self.generations[slab->id] = slab->generation;
+        slab_self.caches[slab->id] = NULL;
+        memset(&slab_self.batches[slab->id], 0, sizeof(slab_batch_t));
+    }
+    return slab_self.caches[slab->id];
+}
+
+static void slab_thread_exit(void *arg)
+{
+    slab_thread_t *self = (slab_thread_t *)arg;
+    slab_t *slab;
+    int id;
+
+    pthread_mutex_lock(&slab_table_mutex);
+    for (id = 0; id < SLAB_MAX; id++) {
+        slab = slab_table[id];
+        if (slab == NULL || self->generations[id] != slab->generation)
+            continue;
+
+        slab_flush_batch(&self->batches[id]);
+        if (self->caches[id] != NULL) {
+            pthread_mutex_lock(&slab->mutex);
+            self->caches[id]->orphan = 1;
+            __atomic_add_fetch(&slab->orphans, 1, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&slab->mutex);
+            self->caches[id] = NULL;
+        }
+    }
+    pthread_mutex_unlock(&slab_table_mutex);
+}
+
+static void slab_init_routine(void)
+{
+    int status;
+
+    status = pthread_key_create(&slab_exit_key, slab_thread_exit);
+    if (status != 0)
+        err_abort(status, "Create slab key");
+}
+
+static int slab_register(void)
+{
+    int status;
+
+    status = pthread_once(&slab_once, slab_init_routine);
+    if (status != 0)
+        return status;
+
+    status = pthread_setspecific(slab_exit_key, &slab_self);
+    if (status != 0)
+        return status;
+
+    slab_self.registered = 1;
+    return 0;
+}
+
+static void slab_fork_prepare(void *arg)
+{
+    int status, id;
+
+    status = pthread_mutex_lock(&slab_table_mutex);
+    if (status != 0)
+        err_abort(status, "Lock slab table in prepare handler");
+
+    for (id = 0; id < SLAB_MAX; id++) {
+        if (slab_table[id] == NULL)
+            continue;
+        status = pthread_mutex_lock(&slab_table[id]->mutex);
+        if (status != 0)
+            err_abort(status, "Lock slab in prepare handler");
+    }
+}
+
+static void slab_fork_parent(void *arg)
+{
+    int status, id;
+
+    for (id = SLAB_MAX - 1; id >= 0; id--) {
+        if (slab_table[id] == NULL)
+            continue;
+        status = pthread_mutex_unlock(&slab_table[id]->mutex);
+        if (status != 0)
+            err_abort(status, "Unlock slab in parent handler");
+    }
+
+    status = pthread_mutex_unlock(&slab_table_mutex);
+    if (status != 0)
+        err_abort(status, "Unlock slab table in parent handler");
+}
+
+/*
+ * The caches of threads that were not forked have no owner in the
+ * child, so they become orphans whose free objects the survivors can
+ * reclaim. Frees they had batched for other caches are lost.
+ */
+static void slab_fork_child(void *arg)
+{
+    slab_cache_t *cache, *own;
+    slab_t *slab;
+    int status, id;
+
+    for (id = SLAB_MAX - 1; id >= 0; id--) {
+        slab = slab_table[id];
+        if (slab == NULL)
+            continue;
+
+        own = slab_local(slab);
+        for (cache = slab->caches; cache != NULL; cache = cache->next) {
+            if (cache != own && !cache->orphan) {
+                cache->orphan = 1;
+                slab->orphans++;
+            }
+        }
+
+        status = pthread_mutex_unlock(&slab->mutex);
+        if (status != 0)
+            err_abort(status, "Unlock slab in child handler");
+    }
+
+    status = pthread_mutex_unlock(&slab_table_mutex);
+    if (status != 0)
+        err_abort(status, "Unlock slab table in child handler");
+}
+
+static void slab_fork_init(void)
+{
+    slab_fork_status = forksafe_register(&slab_fork, FORKSAFE_RANK_SLAB,
+        slab_fork_prepare, slab_fork_parent, slab_fork_child, NULL);
+}
+
+int slab_init(slab_t *slab, size_t size)
+{
+    int status;
+
+    status = pthread_once(&slab_fork_once, slab_fork_init);
+    if (status != 0)
+        return status;
+    if (slab_fork_status != 0)
+        return slab_fork_status;
+
+    status = pthread_mutex_lock(&slab_table_mutex);
+    if (status != 0)
+        return status;
+
+    if (~slab_ids == 0) {
+        pthread_mutex_unlock(&slab_table_mutex);
+        return EAGAIN;
+    }
+
+    status = pthread_mutex_init(&slab->mutex, NULL);
+    if (status != 0) {
+        pthread_mutex_unlock(&slab_table_mutex);
+        return status;
+    }
+
+    slab->caches = NULL;
+    slab->size = size;
+    slab->stride = (sizeof(slab_header_t) + size + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1);
+    slab->generation = ++slab_generation;
+    slab->orphans = 0;
+    slab->id = __builtin_ctzll(~slab_ids);
+    slab_ids |= 1ULL << slab->id;
+    slab->valid = SLAB_VALID;
+    slab_table[slab->id] = slab;
+
+    return pthread_mutex_unlock(&slab_table_mutex);
+}
+
+int slab_destroy(slab_t *slab)
+{
+    slab_cache_t *cache;
+    void *chunk;
+    int status;
+
+    if (slab->valid != SLAB_VALID)
+        return EINVAL;
+
+    status = pthread_mutex_lock(&slab_table_mutex);
+    if (status != 0)
+        return status;
+
+    slab->valid = 0;
+    slab_table[slab->id] = NULL;
+    slab_ids &= ~(1ULL << slab->id);
+    pthread_mutex_unlock(&slab_table_mutex);
+
+    while ((cache = slab->caches) != NULL) {
+        slab->caches = cache->next;
+        while ((chunk = cache->chunks) != NULL) {
+            cache->chunks = *(void **)chunk;
+            free(chunk);
+        }
+        free(cache);
+    }
+
+    slab_self.caches[slab->id] = NULL;
+    return pthread_mutex_destroy(&slab->mutex);
+}
+
+static slab_cache_t *slab_attach(slab_t *slab)
+{
+    slab_cache_t *cache;
+
+    if (!slab_self.registered && slab_register() != 0)
+        return NULL;
+
+    if (pthread_mutex_lock(&slab->mutex) != 0)
+        return NULL;
+
+    for (cache = slab->caches; cache != NULL; cache = cache->next)
+        if (cache->orphan)
+            break;
+
+    if (cache != NULL) {
+        cache->orphan = 0;
+        __atomic_sub_fetch(&slab->orphans, 1, __ATOMIC_RELAXED);
+    } else if (posix_memalign((void **)&cache, SLAB_CACHE_LINE, sizeof(slab_cache_t)) == 0) {
+        mpsc_init(&cache->remote, offsetof(slab_header_t, link));
+        cache->free = NULL;
+        cache->chunks = NULL;
+        cache->orphan = 0;
+        cache->next = slab->caches;
+        slab->caches = cache;
+    } else
+        cache = NULL;
+
+    pthread_mutex_unlock(&slab->mutex);
+    slab_self.caches[slab->id] = cache;
+    return cache;
+}
+
+static void slab_take(slab_cache_t *cache, slab_header_t *list)
+{
+    slab_header_t *next;
+
+    for (; list != NULL; list = next) {
+        next = list->link;
+        list->owner = cache;
+        list->link = cache->free;
+        cache->free = list;
+    }
+}
+
+/*
+ * Objects freed into the cache of a thread that has exited would
+ * otherwise wait for another thread to adopt that cache, so they are
+ * taken over before the slab grows.
+ */
+static void slab_reclaim(slab_t *slab, slab_cache_t *cache)
+{
+    slab_cache_t *orphan;
+
+    if (__atomic_load_n(&slab->orphans, __ATOMIC_RELAXED) == 0
+        || pthread_mutex_lock(&slab->mutex) != 0)
+        return;
+
+    for (orphan = slab->caches; orphan != NULL; orphan = orphan->next) {
+        if (!orphan->orphan)
+            continue;
+        slab_take(cache, (slab_header_t *)mpsc_drain(&orphan->remote));
+        slab_take(cache, orphan->free);
+        orphan->free = NULL;
+    }
+
+    pthread_mutex_unlock(&slab->mutex);
+}
+
+static int slab_refill(slab_t *slab, slab_cache_t *cache)
+{
+    slab_header_t *header;
+    char *chunk, *object;
+    int count;
+
+    slab_flush_batch(&slab_self.batches[slab->id]);
+
+    cache->free = (slab_header_t *)mpsc_drain(&cache->remote);
+    if (cache->free != NULL)
+        return 0;
+
+    slab_reclaim(slab, cache);
+    if (cache->free != NULL)
+        return 0;
+
+    if (posix_memalign((void **)&chunk, SLAB_ALIGN, SLAB_ALIGN + SLAB_CHUNK * slab->stride) != 0)
+        return ENOMEM;
+
+    *(void **)chunk = cache->chunks;
+    cache->chunks = chunk;
+
+    object = chunk + SLAB_ALIGN;
+    for (count = 0; count < SLAB_CHUNK; count++, object += slab->stride) {
+        header = (slab_header_t *)object;
+        header->owner = cache;
+        header->link = cache->free;
+        cache->free = header;
+    }
+
+    return 0;
+}
+
+void *slab_alloc(slab_t *slab)
+{
+    slab_cache_t *cache;
+    slab_header_t *header;
+
+    cache = slab_local(slab);
+    if (cache == NULL) {
+        cache = slab_attach(slab);
+        if (cache == NULL)
+            return NULL;
+    }
+
+    if (cache->free == NULL && slab_refill(slab, cache) != 0)
+        return NULL;
+
+    header = cache->free;
+    cache->free = header->link;
+    return header + 1;
+}
+
+void slab_free(slab_t *slab, void *ptr)
+{
+    slab_header_t *header = (slab_header_t *)ptr - 1;
+    slab_batch_t *batch;
+
+    if (header->owner == slab_local(slab)) {
+        header->link = header->owner->free;
+        header->owner->free = header;
+        return;
+    }
+
+    if (!slab_self.registered)
+        slab_register();
+
+    batch = &slab_self.batches[slab->id];
+    if (batch->owner != header->owner)
+        slab_flush_batch(batch);
+
+    header->link = batch->first;
+    batch->first = header;
+    if (batch->last == NULL)
+        batch->last = header;
+    batch->owner = header->owner;
+
+    if (++batch->count >= SLAB_BATCH)
+        slab_flush_batch(batch);
+}
+
+void slab_flush(slab_t *slab)
+{
+    slab_local(slab);
+    slab_flush_batch(&slab_self.batches[slab->id]);
+}
@@ -0,0 +1,51 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include "mpsc.h"
+
+#define SLAB_MAX        64
+#define SLAB_CHUNK      256
+#define SLAB_BATCH      32
+#define SLAB_CACHE_LINE 64
+#define SLAB_ALIGN      16
+
+/*
+ * Objects start right after their header, so headers are padded and
+ * placed at SLAB_ALIGN to give objects malloc's alignment.
+ */
+typedef struct slab_header_tag {
+    struct slab_header_tag  *link;
+    struct slab_cache_tag   *owner;
+} __attribute__((aligned(SLAB_ALIGN))) slab_header_t;
+
+typedef struct slab_cache_tag {
+    mpsc_t                  remote;
+    char                    pad[SLAB_CACHE_LINE - sizeof(mpsc_t)];
+    slab_header_t           *free;
+    void                    *chunks;
+    struct slab_cache_tag   *next;
+    int                     orphan;
+} __attribute__((aligned(SLAB_CACHE_LINE))) slab_cache_t;
+
+typedef struct slab_tag {
+    pthread_mutex_t     mutex;
+    slab_cache_t        *caches;
+    size_t              size;
+    size_t              stride;
+    unsigned long       generation;
+    int                 orphans;
+    int                 id;
+    int                 valid;
+} slab_t;
+
+#define SLAB_VALID 0x51ab1e
+
+int slab_init(slab_t *slab, size_t size);
+int slab_destroy(slab_t *slab);
+void *slab_alloc(slab_t *slab);
+void slab_free(slab_t *slab, void *ptr);
+void slab_flush(slab_t *slab);
+
+#endif //SLAB_H
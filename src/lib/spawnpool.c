@@ -0,0 +1,267 @@
+#include <limits.h>
+#include <sys/mman.h>
+#include "errors.h"
+#include "spawnpool.h"
+
+static size_t spawn_round(size_t size, size_t page)
+{
+    return (size + page - 1) & ~(page - 1);
+}
+
+int spawn_pool_init(spawn_pool_t *pool, size_t stack_size, size_t guard_size,
+    int max_cached, int flags)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    int status;
+
+    if (stack_size < PTHREAD_STACK_MIN || max_cached < 0)
+        return EINVAL;
+
+    status = pthread_mutex_init(&pool->mutex, NULL);
+    if (status != 0)
+        return status;
+    status = pthread_cond_init(&pool->done, NULL);
+    if (status != 0) {
+        pthread_mutex_destroy(&pool->mutex);
+        return status;
+    }
+
+    pool->cache = pool->finished = NULL;
+    pool->stack_size = spawn_round(stack_size, page);
+    pool->guard_size = spawn_round(guard_size, page);
+    pool->map_size = pool->guard_size + pool->stack_size
+        + spawn_round(sizeof(spawn_thread_t), page);
+    pool->flags = flags;
+    pool->cached = 0;
+    pool->max_cached = max_cached;
+    pool->running = pool->joinable = 0;
+    pool->valid = SPAWN_VALID;
+    return 0;
+}
+
+static void spawn_stack_free(spawn_pool_t *pool, spawn_thread_t *record)
+{
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->cached < pool->max_cached) {
+        record->next = pool->cache;
+        pool->cache = record;
+        pool->cached++;
+        pthread_mutex_unlock(&pool->mutex);
+        return;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    munmap(record->base, pool->map_size);
+}
+
+/*
+ * The record lives above the stack, outside the range handed to
+ * pthread_attr_setstack(), where the implementation keeps its own
+ * thread descriptor and TLS at the top.
+ */
+static spawn_thread_t *spawn_stack_alloc(spawn_pool_t *pool)
+{
+    spawn_thread_t *record;
+    size_t page = sysconf(_SC_PAGESIZE);
+    char *base, *page_ptr;
+
+    pthread_mutex_lock(&pool->mutex);
+    record = pool->cache;
+    if (record != NULL) {
+        pool->cache = record->next;
+        pool->cached--;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    if (record != NULL)
+        return record;
+
+    base = (char *)mmap(NULL, pool->map_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    if (pool->guard_size > 0 && mprotect(base, pool->guard_size, PROT_NONE) != 0) {
+        munmap(base, pool->map_size);
+        return NULL;
+    }
+
+    if (pool->flags & SPAWN_PREFAULT) {
+        for (page_ptr = base + pool->guard_size + pool->stack_size - page;
+            page_ptr >= base + pool->guard_size; page_ptr -= page)
+            *(volatile char *)page_ptr = 0;
+    }
+
+    record = (spawn_thread_t *)(base + pool->guard_size + pool->stack_size);
+    record->base = base;
+    return record;
+}
+
+/*
+ * Joins detached threads that have returned and recycles their stacks.
+ * Their start routine is done, so the join only waits out the last
+ * few instructions of thread exit.
+ */
+static void spawn_reap(spawn_pool_t *pool)
+{
+    spawn_thread_t *record, *next;
+
+    pthread_mutex_lock(&pool->mutex);
+    record = pool->finished;
+    pool->finished = NULL;
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (; record != NULL; record = next) {
+        next = record->next;
+        pthread_join(record->thread, NULL);
+        spawn_stack_free(pool, record);
+    }
+}
+
+static void spawn_finish(void *arg)
+{
+    spawn_thread_t *self = (spawn_thread_t *)arg;
+    spawn_pool_t *pool = self->pool;
+
+    if (!self->detached)
+        return;
+
+    pthread_mutex_lock(&pool->mutex);
+    self->thread = pthread_self();
+    self->next = pool->finished;
+    pool->finished = self;
+    if (--pool->running == 0)
+        pthread_cond_broadcast(&pool->done);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static void *spawn_routine(void *arg)
+{
+    spawn_thread_t *self = (spawn_thread_t *)arg;
+    void *value;
+
+    pthread_cleanup_push(spawn_finish, self);
+    value = self->start(self->arg);
+    pthread_cleanup_pop(1);
+    return value;
+}
+
+/*
+ * Creates a detached thread when thread is NULL, otherwise a joinable
+ * one that must be passed to spawn_join().
+ */
+int spawn_create(spawn_pool_t *pool, spawn_thread_t **thread,
+    void *(*start)(void *), void *arg)
+{
+    spawn_thread_t *record;
+    pthread_attr_t attr;
+    pthread_t id;
+    int status;
+
+    if (pool->valid != SPAWN_VALID)
+        return EINVAL;
+
+    spawn_reap(pool);
+
+    record = spawn_stack_alloc(pool);
+    if (record == NULL)
+        return EAGAIN;
+
+    record->pool = pool;
+    record->start = start;
+    record->arg = arg;
+    record->detached = thread == NULL;
+
+    status = pthread_attr_init(&attr);
+    if (status != 0) {
+        spawn_stack_free(pool, record);
+        return status;
+    }
+    status = pthread_attr_setstack(&attr, record->base + pool->guard_size, pool->stack_size);
+    if (status != 0) {
+        pthread_attr_destroy(&attr);
+        spawn_stack_free(pool, record);
+        return status;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    if (record->detached)
+        pool->running++;
+    else
+        pool->joinable++;
+    pthread_mutex_unlock(&pool->mutex);
+
+    status = pthread_create(&id, &attr, spawn_routine, (void *)record);
+    pthread_attr_destroy(&attr);
+    if (status != 0) {
+        pthread_mutex_lock(&pool->mutex);
+        if (record->detached)
+            pool->running--;
+        else
+            pool->joinable--;
+        pthread_mutex_unlock(&pool->mutex);
+        spawn_stack_free(pool, record);
+        return status;
+    }
+
+    if (thread != NULL) {
+        record->thread = id;
+        *thread = record;
+    }
+    return 0;
+}
+
+int spawn_join(spawn_thread_t *thread, void **value)
+{
+    spawn_pool_t *pool = thread->pool;
+    int status;
+
+    if (thread->detached)
+        return EINVAL;
+
+    status = pthread_join(thread->thread, value);
+    if (status != 0)
+        return status;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->joinable--;
+    pthread_mutex_unlock(&pool->mutex);
+
+    spawn_stack_free(pool, thread);
+    return 0;
+}
+
+/*
+ * Waits for running detached threads, then unmaps every stack. Fails
+ * with EBUSY while joinable threads have not been joined.
+ */
+int spawn_pool_destroy(spawn_pool_t *pool)
+{
+    spawn_thread_t *record;
+    int status;
+
+    if (pool->valid != SPAWN_VALID)
+        return EINVAL;
+
+    status = pthread_mutex_lock(&pool->mutex);
+    if (status != 0)
+        return status;
+
+    if (pool->joinable > 0) {
+        pthread_mutex_unlock(&pool->mutex);
+        return EBUSY;
+    }
+    pool->valid = 0;
+    while (pool->running > 0)
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    pool->max_cached = 0;
+    pthread_mutex_unlock(&pool->mutex);
+
+    spawn_reap(pool);
+    while ((record = pool->cache) != NULL) {
+        pool->cache = record->next;
+        munmap(record->base, pool->map_size);
+    }
+    pool->cached = 0;
+
+    pthread_mutex_destroy(&pool->mutex);
+    return pthread_cond_destroy(&pool->done);
+}
@@ -0,0 +1,56 @@
+#ifndef SPAWNPOOL_H
+#define SPAWNPOOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#define SPAWN_PREFAULT      0x1
+
+typedef struct spawn_thread_tag {
+    struct spawn_thread_tag     *next;
+    struct spawn_pool_tag       *pool;
+    pthread_t                   thread;
+    char                        *base;
+    void                        *(*start)(void *);
+    void                        *arg;
+    int                         detached;
+} spawn_thread_t;
+
+/*
+ * Creates threads on stacks the pool maps itself, stack_size bytes
+ * below the thread record with guard_size bytes of PROT_NONE under
+ * them. Stacks of finished threads are kept (up to max_cached) and
+ * handed to the next thread, skipping the mmap, guard mprotect and
+ * page faults of a fresh stack. SPAWN_PREFAULT touches every page of
+ * a new stack before the thread starts.
+ *
+ * Detached threads are joined internally once they have returned, by
+ * the next spawn_create() or by spawn_pool_destroy(), since a stack
+ * may only be reused after its thread has completely exited.
+ */
+typedef struct spawn_pool_tag {
+    pthread_mutex_t     mutex;
+    pthread_cond_t      done;
+    spawn_thread_t      *cache;
+    spawn_thread_t      *finished;
+    size_t              stack_size;
+    size_t              guard_size;
+    size_t              map_size;
+    int                 flags;
+    int                 cached;
+    int                 max_cached;
+    int                 running;
+    int                 joinable;
+    int                 valid;
+} spawn_pool_t;
+
+#define SPAWN_VALID 0x5ba3f1
+
+int spawn_pool_init(spawn_pool_t *pool, size_t stack_size, size_t guard_size,
+    int max_cached, int flags);
+int spawn_pool_destroy(spawn_pool_t *pool);
+int spawn_create(spawn_pool_t *pool, spawn_thread_t **thread,
+    void *(*start)(void *), void *arg);
+int spawn_join(spawn_thread_t *thread, void **value);
+
+#endif //SPAWNPOOL_H
@@ -0,0 +1,67 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <errno.h>
+#include <stdlib.h>
+
+#define SPSC_CACHE_LINE 64
+
+/*
+ * Bounded single-producer/single-consumer ring of pointers. The producer
+ * owns head and the consumer owns tail; each only reads the other's
+ * index, so push and pop are a load, a store and no read-modify-write.
+ */
+typedef struct spsc_tag {
+    unsigned long   head;
+    char            pad1[SPSC_CACHE_LINE - sizeof(unsigned long)];
+    unsigned long   tail;
+    char            pad2[SPSC_CACHE_LINE - sizeof(unsigned long)];
+    unsigned long   mask;
+    void            **slots;
+} __attribute__((aligned(SPSC_CACHE_LINE))) spsc_t;
+
+static inline int spsc_init(spsc_t *q, unsigned long capacity)
+{
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+        return EINVAL;
+
+    q->slots = (void **)malloc(capacity * sizeof(void *));
+    if (q->slots == NULL)
+        return ENOMEM;
+
+    q->head = q->tail = 0;
+    q->mask = capacity - 1;
+    return 0;
+}
+
+static inline void spsc_destroy(spsc_t *q)
+{
+    free(q->slots);
+}
+
+static inline int spsc_push(spsc_t *q, void *item)
+{
+    unsigned long head = q->head;
+
+    if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) > q->mask)
+        return 0;
+
+    q->slots[head & q->mask] = item;
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static inline void *spsc_pop(spsc_t *q)
+{
+    unsigned long tail = q->tail;
+    void *item;
+
+    if (tail == __atomic_load_n(&q->head, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    item = q->slots[tail & q->mask];
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    return item;
+}
+
+#endif //SPSC_H
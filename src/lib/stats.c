@@ -0,0 +1,77 @@
+#include "errors.h"
+#include "stats.h"
+
+static int stats_next_slot = 0;
+static __thread int stats_thread_slot = -1;
+
+int stats_slot(void)
+{
+    if (stats_thread_slot < 0)
+        stats_thread_slot = __atomic_fetch_add(&stats_next_slot, 1, __ATOMIC_RELAXED) % STATS_SLOTS;
+    return stats_thread_slot;
+}
+
+int stats_counter_init(stats_counter_t *counter)
+{
+    memset(counter, 0, sizeof(stats_counter_t));
+    return 0;
+}
+
+long stats_counter_read(stats_counter_t *counter)
+{
+    long sum = 0;
+    int slot;
+
+    for (slot = 0; slot < STATS_SLOTS; slot++)
+        sum += __atomic_load_n(&counter->slots[slot].value, __ATOMIC_RELAXED);
+    return sum;
+}
+
+int stats_histogram_init(stats_histogram_t *histogram)
+{
+    memset(histogram, 0, sizeof(stats_histogram_t));
+    return 0;
+}
+
+unsigned long stats_histogram_read(stats_histogram_t *histogram, unsigned long buckets[STATS_BUCKETS])
+{
+    unsigned long total = 0;
+    int slot, bucket;
+
+    for (bucket = 0; bucket < STATS_BUCKETS; bucket++)
+        buckets[bucket] = 0;
+
+    for (slot = 0; slot < STATS_SLOTS; slot++) {
+        for (bucket = 0; bucket < STATS_BUCKETS; bucket++) {
+            buckets[bucket] += __atomic_load_n(&histogram->slots[slot].buckets[bucket],
+                __ATOMIC_RELAXED);
+        }
+    }
+
+    for (bucket = 0; bucket < STATS_BUCKETS; bucket++)
+        total += buckets[bucket];
+    return total;
+}
+
+uint64_t stats_histogram_percentile(stats_histogram_t *histogram, double percentile)
+{
+    unsigned long buckets[STATS_BUCKETS];
+    unsigned long total, rank, seen = 0;
+    int bucket;
+
+    total = stats_histogram_read(histogram, buckets);
+    if (total == 0)
+        return 0;
+
+    rank = (unsigned long)(total * percentile / 100.0);
+    if (rank >= total)
+        rank = total - 1;
+
+    for (bucket = 0; bucket < STATS_BUCKETS; bucket++) {
+        seen += buckets[bucket];
+        if (seen > rank)
+            break;
+    }
+
+    return bucket == 0 ? 0 : (1ULL << bucket) - 1;
+}
@@ -0,0 +1,68 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+#define STATS_CACHE_LINE    64
+#define STATS_SLOTS         64
+#define STATS_BUCKETS       64
+
+typedef struct stats_slot_tag {
+    long        value;
+} __attribute__((aligned(STATS_CACHE_LINE))) stats_slot_t;
+
+typedef struct stats_counter_tag {
+    stats_slot_t    slots[STATS_SLOTS];
+} stats_counter_t;
+
+typedef stats_counter_t stats_gauge_t;
+
+typedef struct stats_hslot_tag {
+    unsigned long   buckets[STATS_BUCKETS];
+} __attribute__((aligned(STATS_CACHE_LINE))) stats_hslot_t;
+
+typedef struct stats_histogram_tag {
+    stats_hslot_t   slots[STATS_SLOTS];
+} stats_histogram_t;
+
+int stats_slot(void);
+
+static inline void stats_counter_add(stats_counter_t *counter, long delta)
+{
+    __atomic_fetch_add(&counter->slots[stats_slot()].value, delta, __ATOMIC_RELAXED);
+}
+
+static inline void stats_counter_inc(stats_counter_t *counter)
+{
+    stats_counter_add(counter, 1);
+}
+
+static inline void stats_gauge_add(stats_gauge_t *gauge, long delta)
+{
+    stats_counter_add(gauge, delta);
+}
+
+static inline int stats_bucket(uint64_t value)
+{
+    return value == 0 ? 0 : 64 - __builtin_clzll(value);
+}
+
+static inline void stats_histogram_record(stats_histogram_t *histogram, uint64_t value)
+{
+    int bucket = stats_bucket(value);
+
+    if (bucket >= STATS_BUCKETS)
+        bucket = STATS_BUCKETS - 1;
+    __atomic_fetch_add(&histogram->slots[stats_slot()].buckets[bucket], 1, __ATOMIC_RELAXED);
+}
+
+int stats_counter_init(stats_counter_t *counter);
+long stats_counter_read(stats_counter_t *counter);
+#define stats_gauge_init(gauge) stats_counter_init(gauge)
+#define stats_gauge_read(gauge) stats_counter_read(gauge)
+
+int stats_histogram_init(stats_histogram_t *histogram);
+unsigned long stats_histogram_read(stats_histogram_t *histogram, unsigned long buckets[STATS_BUCKETS]);
+uint64_t stats_histogram_percentile(stats_histogram_t *histogram, double percentile);
+
+#endif //STATS_H
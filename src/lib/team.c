@@ -0,0 +1,223 @@
+#include "errors.h"
+#include "team.h"
+#include "schedprof.h"
+
+static void team_work(team_t *team)
+{
+    int index, status, error;
+
+    while ((index = __atomic_fetch_add(&team->next, 1, __ATOMIC_RELAXED)) < team->n) {
+        status = team->fn(index, team->arg, &team->cancel);
+        if (status != 0) {
+            error = 0;
+            if (__atomic_compare_exchange_n(&team->error, &error, status, 0,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                token_cancel(&team->cancel);
+        }
+        __atomic_sub_fetch(&team->remaining, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void *team_server(void *arg)
+{
+    team_t *team = (team_t *)arg;
+    unsigned long seen = 0;
+    int status;
+
+    status = pthread_mutex_lock(&team->mutex);
+    if (status != 0)
+        err_abort(status, "Lock team");
+
+    while (1) {
+        while (team->generation == seen && !team->quit) {
+            status = pthread_cond_wait(&team->start_cv, &team->mutex);
+            if (status != 0)
+                err_abort(status, "Wait for team phase");
+        }
+        if (team->quit)
+            break;
+
+        seen = team->generation;
+        team->active++;
+        pthread_mutex_unlock(&team->mutex);
+
+        team_work(team);
+
+        status = pthread_mutex_lock(&team->mutex);
+        if (status != 0)
+            err_abort(status, "Lock team");
+        if (--team->active == 0)
+            pthread_cond_signal(&team->done_cv);
+    }
+
+    pthread_mutex_unlock(&team->mutex);
+    return NULL;
+}
+
+int team_init(team_t *team, int threads)
+{
+    return team_init_profile(team, threads, SCHEDPROF_DEFAULT);
+}
+
+int team_init_profile(team_t *team, int threads, int profile)
+{
+    int status, count;
+
+    if (threads < 0)
+        return EINVAL;
+
+    team->threads = (pthread_t *)malloc((threads ? threads : 1) * sizeof(pthread_t));
+    if (team->threads == NULL)
+        return ENOMEM;
+
+    status = pthread_mutex_init(&team->mutex, NULL);
+    if (status != 0)
+        goto free_threads;
+    status = pthread_cond_init(&team->start_cv, NULL);
+    if (status != 0)
+        goto destroy_mutex;
+    status = pthread_cond_init(&team->done_cv, NULL);
+    if (status != 0)
+        goto destroy_start_cv;
+    status = token_init(&team->cancel, NULL);
+    if (status != 0)
+        goto destroy_done_cv;
+
+    team->generation = 0;
+    team->size = 0;
+    team->n = team->next = team->remaining = 0;
+    team->active = 0;
+    team->error = 0;
+    team->quit = 0;
+
+    for (count = 0; count < threads; count++) {
+        status = schedprof_create(&team->threads[count], NULL, profile, count,
+            team_server, (void *)team, NULL);
+        if (status != 0)
+            break;
+        team->size++;
+    }
+
+    team->valid = TEAM_VALID;
+    if (status != 0) {
+        team_destroy(team);
+        return status;
+    }
+    return 0;
+
+destroy_done_cv:
+    pthread_cond_destroy(&team->done_cv);
+destroy_start_cv:
+    pthread_cond_destroy(&team->start_cv);
+destroy_mutex:
+    pthread_mutex_destroy(&team->mutex);
+free_threads:
+    free(team->threads);
+    return status;
+}
+
+int team_destroy(team_t *team)
+{
+    int status, count;
+
+    if (team->valid != TEAM_VALID)
+        return EINVAL;
+
+    status = pthread_mutex_lock(&team->mutex);
+    if (status != 0)
+        return status;
+    team->valid = 0;
+    team->quit = 1;
+    pthread_cond_broadcast(&team->start_cv);
+    pthread_mutex_unlock(&team->mutex);
+
+    for (count = 0; count < team->size; count++) {
+        status = pthread_join(team->threads[count], NULL);
+        if (status != 0)
+            return status;
+    }
+    free(team->threads);
+
+    token_destroy(&team->cancel);
+    pthread_cond_destroy(&team->done_cv);
+    pthread_cond_destroy(&team->start_cv);
+    return pthread_mutex_destroy(&team->mutex);
+}
+
+int team_run(team_t *team, int n, team_fn_t fn, void *arg)
+{
+    int status, count;
+
+    if (team->valid != TEAM_VALID || n < 0 || fn == NULL)
+        return EINVAL;
+    if (n == 0)
+        return 0;
+
+    status = pthread_mutex_lock(&team->mutex);
+    if (status != 0)
+        return status;
+
+    while (team->active > 0) {
+        status = pthread_cond_wait(&team->done_cv, &team->mutex);
+        if (status != 0) {
+            pthread_mutex_unlock(&team->mutex);
+            return status;
+        }
+    }
+
+    token_destroy(&team->cancel);
+    status = token_init(&team->cancel, NULL);
+    if (status != 0) {
+        pthread_mutex_unlock(&team->mutex);
+        return status;
+    }
+
+    team->fn = fn;
+    team->arg = arg;
+    team->n = n;
+    team->next = 0;
+    team->remaining = n;
+    team->error = 0;
+
+    if (n > 1 && team->size > 0) {
+        team->generation++;
+        if (n - 1 >= team->size)
+            pthread_cond_broadcast(&team->start_cv);
+        else {
+            for (count = 0; count < n - 1; count++)
+                pthread_cond_signal(&team->start_cv);
+        }
+    }
+    pthread_mutex_unlock(&team->mutex);
+
+    team_work(team);
+
+    status = pthread_mutex_lock(&team->mutex);
+    if (status != 0)
+        return status;
+    while (team->active > 0 || __atomic_load_n(&team->remaining, __ATOMIC_ACQUIRE) > 0) {
+        status = pthread_cond_wait(&team->done_cv, &team->mutex);
+        if (status != 0) {
+            pthread_mutex_unlock(&team->mutex);
+            return status;
+        }
+    }
+    pthread_mutex_unlock(&team->mutex);
+
+    return team->error;
+}
+
+int team_cancel(team_t *team)
+{
+    int status;
+
+    if (team->valid != TEAM_VALID)
+        return EINVAL;
+
+    status = pthread_mutex_lock(&team->mutex);
+    if (status != 0)
+        return status;
+    status = token_cancel(&team->cancel);
+    pthread_mutex_unlock(&team->mutex);
+    return status;
+}
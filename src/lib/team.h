@@ -0,0 +1,42 @@
+#ifndef TEAM_H
+#define TEAM_H
+
+#include <pthread.h>
+#include "token.h"
+
+typedef int (*team_fn_t)(int index, void *arg, token_t *cancel);
+
+/*
+ * A pool of threads for repeated fork-join phases. team_run() hands out
+ * indices 0..n-1 to the pooled threads and the caller, and returns once
+ * every index has finished. The first non-zero result is returned and
+ * cancels the phase's token so that siblings can stop early.
+ */
+typedef struct team_tag {
+    pthread_mutex_t     mutex;
+    pthread_cond_t      start_cv;
+    pthread_cond_t      done_cv;
+    pthread_t           *threads;
+    token_t             cancel;
+    team_fn_t           fn;
+    void                *arg;
+    unsigned long       generation;
+    int                 size;
+    int                 n;
+    int                 next;
+    int                 remaining;
+    int                 active;
+    int                 error;
+    int                 quit;
+    int                 valid;
+} team_t;
+
+#define TEAM_VALID 0x7ea3f0
+
+int team_init(team_t *team, int threads);
+int team_init_profile(team_t *team, int threads, int profile);
+int team_destroy(team_t *team);
+int team_run(team_t *team, int n, team_fn_t fn, void *arg);
+int team_cancel(team_t *team);
+
+#endif //TEAM_H
@@ -0,0 +1,742 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <time.h>
+#include "errors.h"
+#include "timer.h"
+#include "schedprof.h"
+
+#define TIMER_HEAP_INITIAL 64
+
+uint64_t timer_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * TIMER_NSEC_PER_SEC + now.tv_nsec;
+}
+
+static void timer_heap_set(timer_shard_t *shard, int index, timer_event_t *event)
+{
+    shard->heap[index] = event;
+    event->index = index;
+}
+
+static void timer_heap_up(timer_shard_t *shard, int index)
+{
+    timer_event_t *event = shard->heap[index];
+    int parent;
+
+    while (index > 0) {
+        parent = (index - 1) / 2;
+        if (shard->heap[parent]->latest <= event->latest)
+            break;
+        timer_heap_set(shard, index, shard->heap[parent]);
+        index = parent;
+    }
+    timer_heap_set(shard, index, event);
+}
+
+static void timer_heap_down(timer_shard_t *shard, int index)
+{
+    timer_event_t *event = shard->heap[index];
+    int depth = shard->stats.depth;
+    int child;
+
+    while ((child = index * 2 + 1) < depth) {
+        if (child + 1 < depth
+            && shard->heap[child + 1]->latest < shard->heap[child]->latest)
+            child++;
+        if (event->latest <= shard->heap[child]->latest)
+            break;
+        timer_heap_set(shard, index, shard->heap[child]);
+        index = child;
+    }
+    timer_heap_set(shard, index, event);
+}
+
+static int timer_heap_insert(timer_shard_t *shard, timer_event_t *event)
+{
+    timer_event_t **heap;
+
+    if (shard->stats.depth == shard->capacity) {
+        heap = (timer_event_t **)realloc(shard->heap,
+            shard->capacity * 2 * sizeof(timer_event_t *));
+        if (heap == NULL)
+            return ENOMEM;
+        shard->heap = heap;
+        shard->capacity *= 2;
+    }
+
+    shard->heap[shard->stats.depth] = event;
+    timer_heap_up(shard, shard->stats.depth++);
+    return 0;
+}
+
+static void timer_heap_remove(timer_shard_t *shard, int index)
+{
+    timer_event_t *last = shard->heap[--shard->stats.depth];
+
+    if (index == shard->stats.depth)
+        return;
+
+    timer_heap_set(shard, index, last);
+    timer_heap_down(shard, index);
+    timer_heap_up(shard, last->index);
+}
+
+/*
+ * Ids are sequence * nshards + shard, so the sequence part spreads a
+ * shard's ids evenly over its buckets.
+ */
+static int timer_hash_bucket(timer_shard_t *shard, int nbuckets, timer_id_t id)
+{
+    return (id / shard->service->nshards) & (nbuckets - 1);
+}
+
+static timer_event_t **timer_hash_slot(timer_shard_t *shard, timer_id_t id)
+{
+    timer_event_t **slot;
+
+    slot = &shard->buckets[timer_hash_bucket(shard, shard->nbuckets, id)];
+    while (*slot != NULL && (*slot)->id != id)
+        slot = &(*slot)->hash_link;
+    return slot;
+}
+
+static void timer_hash_insert(timer_shard_t *shard, timer_event_t *event)
+{
+    timer_event_t **buckets, **slot, *next, *chain;
+    int nbuckets, count;
+
+    /* If the table cannot grow the chains just get longer. */
+    if (shard->hashed >= shard->nbuckets) {
+        nbuckets = shard->nbuckets * 2;
+        buckets = (timer_event_t **)calloc(nbuckets, sizeof(timer_event_t *));
+        if (buckets != NULL) {
+            for (count = 0; count < shard->nbuckets; count++) {
+                for (chain = shard->buckets[count]; chain != NULL; chain = next) {
+                    next = chain->hash_link;
+                    slot = &buckets[timer_hash_bucket(shard, nbuckets, chain->id)];
+                    chain->hash_link = *slot;
+                    *slot = chain;
+                }
+            }
+            free(shard->buckets);
+            shard->buckets = buckets;
+            shard->nbuckets = nbuckets;
+        }
+    }
+
+    slot = &shard->buckets[timer_hash_bucket(shard, shard->nbuckets, event->id)];
+    event->hash_link = *slot;
+    *slot = event;
+    shard->hashed++;
+}
+
+static void timer_hash_remove(timer_shard_t *shard, timer_event_t *event)
+{
+    timer_event_t **slot = timer_hash_slot(shard, event->id);
+
+    *slot = event->hash_link;
+    shard->hashed--;
+}
+
+static void *timer_alarm_thread(void *arg)
+{
+    timer_shard_t *shard = (timer_shard_t *)arg;
+    timer_service_t *ts = shard->service;
+    timer_event_t *event, *expired, *tail;
+    struct timespec cond_time;
+    uint64_t now, lag;
+    int status;
+
+    status = pthread_mutex_lock(&shard->mutex);
+    if (status != 0)
+        err_abort(status, "Lock shard mutex");
+
+    while (1) {
+        while (shard->stats.depth == 0 && !shard->quit) {
+            status = pthread_cond_wait(&shard->cv, &shard->mutex);
+            if (status != 0)
+                err_abort(status, "Wait on shard cond");
+            shard->stats.wakeups++;
+        }
+
+        if (shard->quit)
+            break;
+
+        /*
+         * The heap is ordered by the end of each timer's slack window, so
+         * sleeping until the top's latest expiry is the longest sleep that
+         * keeps every window intact. On wakeup everything whose window has
+         * opened fires in one pass.
+         */
+        now = timer_now();
+        if (shard->heap[0]->deadline > now) {
+            cond_time.tv_sec = shard->heap[0]->latest / TIMER_NSEC_PER_SEC;
+            cond_time.tv_nsec = shard->heap[0]->latest % TIMER_NSEC_PER_SEC;
+            status = pthread_cond_timedwait(&shard->cv, &shard->mutex, &cond_time);
+            if (status != 0 && status != ETIMEDOUT)
+                err_abort(status, "Shard timedwait");
+            shard->stats.wakeups++;
+            continue;
+        }
+
+        expired = tail = NULL;
+        while (shard->stats.depth > 0 && shard->heap[0]->deadline <= now) {
+            event = shard->heap[0];
+            timer_heap_remove(shard, 0);
+
+            lag = now - event->deadline;
+            shard->stats.fired++;
+            shard->stats.lag_total += lag;
+            if (lag > shard->stats.lag_max)
+                shard->stats.lag_max = lag;
+
+            event->index = TIMER_QUEUED;
+            event->link = NULL;
+            event->prev = tail;
+            if (tail == NULL)
+                expired = event;
+            else
+                tail->link = event;
+            tail = event;
+        }
+
+        status = pthread_mutex_lock(&ts->work_mutex);
+        if (status != 0)
+            err_abort(status, "Lock work mutex");
+
+        if (ts->first == NULL)
+            ts->first = expired;
+        else
+            ts->last->link = expired;
+        expired->prev = ts->last;
+        ts->last = tail;
+
+        status = pthread_cond_broadcast(&ts->work_cv);
+        if (status != 0)
+            err_abort(status, "Broadcast work cond");
+
+        status = pthread_mutex_unlock(&ts->work_mutex);
+        if (status != 0)
+            err_abort(status, "Unlock work mutex");
+    }
+
+    pthread_mutex_unlock(&shard->mutex);
+    return NULL;
+}
+
+static void *timer_worker(void *arg)
+{
+    timer_service_t *ts = (timer_service_t *)arg;
+    timer_shard_t *shard;
+    timer_event_t *event;
+    int status;
+
+    status = pthread_mutex_lock(&ts->work_mutex);
+    if (status != 0)
+        err_abort(status, "Lock work mutex");
+
+    while (1) {
+        while (ts->first == NULL && !ts->quit) {
+            status = pthread_cond_wait(&ts->work_cv, &ts->work_mutex);
+            if (status != 0)
+                err_abort(status, "Wait on work cond");
+        }
+
+        event = ts->first;
+        if (event == NULL)
+            break;
+
+        ts->first = event->link;
+        if (ts->first != NULL)
+            ts->first->prev = NULL;
+        else
+            ts->last = NULL;
+        __atomic_store_n(&event->index, TIMER_RUNNING, __ATOMIC_RELAXED);
+
+        status = pthread_mutex_unlock(&ts->work_mutex);
+        if (status != 0)
+            err_abort(status, "Unlock work mutex");
+
+        shard = &ts->shards[event->id % ts->nshards];
+        status = pthread_mutex_lock(&shard->mutex);
+        if (status != 0)
+            err_abort(status, "Lock shard mutex");
+        timer_hash_remove(shard, event);
+        status = pthread_mutex_unlock(&shard->mutex);
+        if (status != 0)
+            err_abort(status, "Unlock shard mutex");
+
+        event->callback(event->arg);
+        free(event);
+
+        status = pthread_mutex_lock(&ts->work_mutex);
+        if (status != 0)
+            err_abort(status, "Lock work mutex");
+    }
+
+    pthread_mutex_unlock(&ts->work_mutex);
+    return NULL;
+}
+
+static int timer_cond_init(pthread_cond_t *cv)
+{
+    pthread_condattr_t attr;
+    int status;
+
+    status = pthread_condattr_init(&attr);
+    if (status != 0)
+        return status;
+
+    status = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if (status == 0)
+        status = pthread_cond_init(cv, &attr);
+    pthread_condattr_destroy(&attr);
+    return status;
+}
+
+static int timer_shard_init(timer_service_t *ts, timer_shard_t *shard, int index,
+    int profile)
+{
+    int status;
+
+    shard->service = ts;
+    shard->index = index;
+    shard->quit = 0;
+    shard->next_id = 1;
+    memset(&shard->stats, 0, sizeof(shard->stats));
+
+    shard->capacity = TIMER_HEAP_INITIAL;
+    shard->heap = (timer_event_t **)malloc(shard->capacity * sizeof(timer_event_t *));
+    if (shard->heap == NULL)
+        return ENOMEM;
+
+    shard->nbuckets = TIMER_HEAP_INITIAL;
+    shard->hashed = 0;
+    shard->buckets = (timer_event_t **)calloc(shard->nbuckets, sizeof(timer_event_t *));
+    if (shard->buckets == NULL) {
+        status = ENOMEM;
+        goto free_heap;
+    }
+
+    status = pthread_mutex_init(&shard->mutex, NULL);
+    if (status != 0)
+        goto free_buckets;
+
+    status = timer_cond_init(&shard->cv);
+    if (status != 0)
+        goto destroy_mutex;
+
+    status = schedprof_create(&shard->alarm_thread, NULL, profile, index,
+        timer_alarm_thread, (void *)shard, NULL);
+    if (status != 0)
+        goto destroy_cv;
+
+    return 0;
+
+destroy_cv:
+    pthread_cond_destroy(&shard->cv);
+destroy_mutex:
+    pthread_mutex_destroy(&shard->mutex);
+free_buckets:
+    free(shard->buckets);
+free_heap:
+    free(shard->heap);
+    return status;
+}
+
+static int timer_shard_stop(timer_shard_t *shard)
+{
+    int status;
+
+    status = pthread_mutex_lock(&shard->mutex);
+    if (status != 0)
+        return status;
+
+    shard->quit = 1;
+    status = pthread_cond_signal(&shard->cv);
+    pthread_mutex_unlock(&shard->mutex);
+    if (status != 0)
+        return status;
+
+    return pthread_join(shard->alarm_thread, NULL);
+}
+
+/*
+ * Runs once the alarm thread and the workers have stopped, so the
+ * events left are the ones still in the heap.
+ */
+static int timer_shard_destroy(timer_shard_t *shard)
+{
+    int status, status1;
+
+    while (shard->stats.depth > 0)
+        free(shard->heap[--shard->stats.depth]);
+    free(shard->heap);
+    free(shard->buckets);
+
+    status = pthread_mutex_destroy(&shard->mutex);
+    status1 = pthread_cond_destroy(&shard->cv);
+    return (status ? status : status1);
+}
+
+static int timer_workers_stop(timer_service_t *ts, int count)
+{
+    int status;
+
+    status = pthread_mutex_lock(&ts->work_mutex);
+    if (status != 0)
+        return status;
+
+    ts->quit = 1;
+    status = pthread_cond_broadcast(&ts->work_cv);
+    pthread_mutex_unlock(&ts->work_mutex);
+    if (status != 0)
+        return status;
+
+    while (--count >= 0) {
+        status = pthread_join(ts->workers[count], NULL);
+        if (status != 0)
+            return status;
+    }
+
+    return 0;
+}
+
+/*
+ * An alarm thread holds its shard's mutex when it takes work_mutex, so
+ * the shards are locked first.
+ */
+static void timer_fork_prepare(void *arg)
+{
+    timer_service_t *ts = (timer_service_t *)arg;
+    int status, count;
+
+    for (count = 0; count < ts->nshards; count++) {
+        status = pthread_mutex_lock(&ts->shards[count].mutex);
+        if (status != 0)
+            err_abort(status, "Lock shard mutex in prepare handler");
+    }
+
+    status = pthread_mutex_lock(&ts->work_mutex);
+    if (status != 0)
+        err_abort(status, "Lock work mutex in prepare handler");
+}
+
+static void timer_fork_parent(void *arg)
+{
+    timer_service_t *ts = (timer_service_t *)arg;
+    int status, count;
+
+    status = pthread_mutex_unlock(&ts->work_mutex);
+    if (status != 0)
+        err_abort(status, "Unlock work mutex in parent handler");
+
+    for (count = ts->nshards - 1; count >= 0; count--) {
+        status = pthread_mutex_unlock(&ts->shards[count].mutex);
+        if (status != 0)
+            err_abort(status, "Unlock shard mutex in parent handler");
+    }
+}
+
+/*
+ * Only the forking thread survives, so the child restarts the workers
+ * and alarm threads. Pending timers fire in the child as well as in the
+ * parent; those that were running in a worker at the fork are lost.
+ */
+static void timer_fork_child(void *arg)
+{
+    timer_service_t *ts = (timer_service_t *)arg;
+    timer_shard_t *shard;
+    int status, count;
+
+    status = pthread_cond_init(&ts->work_cv, NULL);
+    if (status != 0)
+        err_abort(status, "Reinit work cond in child handler");
+
+    for (count = 0; count < ts->parallelism; count++) {
+        status = pthread_create(&ts->workers[count], NULL, timer_worker, (void *)ts);
+        if (status != 0)
+            err_abort(status, "Restart timer worker in child handler");
+    }
+
+    status = pthread_mutex_unlock(&ts->work_mutex);
+    if (status != 0)
+        err_abort(status, "Unlock work mutex in child handler");
+
+    for (count = ts->nshards - 1; count >= 0; count--) {
+        shard = &ts->shards[count];
+        status = timer_cond_init(&shard->cv);
+        if (status != 0)
+            err_abort(status, "Reinit shard cond in child handler");
+
+        status = schedprof_create(&shard->alarm_thread, NULL, ts->profile, count,
+            timer_alarm_thread, (void *)shard, NULL);
+        if (status != 0)
+            err_abort(status, "Restart alarm thread in child handler");
+
+        status = pthread_mutex_unlock(&shard->mutex);
+        if (status != 0)
+            err_abort(status, "Unlock shard mutex in child handler");
+    }
+}
+
+int timer_service_init(timer_service_t *ts, int shards, int workers)
+{
+    return timer_service_init_profile(ts, shards, workers, SCHEDPROF_DEFAULT);
+}
+
+int timer_service_init_profile(timer_service_t *ts, int shards, int workers,
+    int alarm_profile)
+{
+    int status, count;
+
+    if (shards < 1 || workers < 1)
+        return EINVAL;
+
+    ts->workers = (pthread_t *)malloc(workers * sizeof(pthread_t));
+    if (ts->workers == NULL)
+        return ENOMEM;
+
+    status = posix_memalign((void **)&ts->shards, TIMER_CACHE_LINE,
+        shards * sizeof(timer_shard_t));
+    if (status != 0) {
+        free(ts->workers);
+        return status;
+    }
+
+    ts->first = ts->last = NULL;
+    ts->quit = 0;
+    ts->nshards = shards;
+    ts->parallelism = workers;
+    ts->profile = alarm_profile;
+
+    status = pthread_mutex_init(&ts->work_mutex, NULL);
+    if (status != 0)
+        goto free_arrays;
+
+    status = pthread_cond_init(&ts->work_cv, NULL);
+    if (status != 0)
+        goto destroy_work_mutex;
+
+    for (count = 0; count < workers; count++) {
+        status = pthread_create(&ts->workers[count], NULL, timer_worker, (void *)ts);
+        if (status != 0) {
+            timer_workers_stop(ts, count);
+            goto destroy_work_cv;
+        }
+    }
+
+    for (count = 0; count < shards; count++) {
+        status = timer_shard_init(ts, &ts->shards[count], count, alarm_profile);
+        if (status != 0)
+            goto stop_shards;
+    }
+
+    status = forksafe_register(&ts->fork, FORKSAFE_RANK_TIMER,
+        timer_fork_prepare, timer_fork_parent, timer_fork_child, (void *)ts);
+    if (status != 0)
+        goto stop_shards;
+
+    ts->valid = TIMER_VALID;
+    return 0;
+
+stop_shards:
+    while (--count >= 0) {
+        timer_shard_stop(&ts->shards[count]);
+        timer_shard_destroy(&ts->shards[count]);
+    }
+    timer_workers_stop(ts, workers);
+destroy_work_cv:
+    pthread_cond_destroy(&ts->work_cv);
+destroy_work_mutex:
+    pthread_mutex_destroy(&ts->work_mutex);
+free_arrays:
+    free(ts->shards);
+    free(ts->workers);
+    return status;
+}
+
+int timer_service_destroy(timer_service_t *ts)
+{
+    int status, status1, count;
+
+    if (ts->valid != TIMER_VALID)
+        return EINVAL;
+
+    ts->valid = 0;
+
+    status = forksafe_unregister(&ts->fork);
+    if (status != 0)
+        return status;
+
+    for (count = 0; count < ts->nshards; count++) {
+        status = timer_shard_stop(&ts->shards[count]);
+        if (status != 0)
+            return status;
+    }
+
+    status = timer_workers_stop(ts, ts->parallelism);
+    if (status != 0)
+        return status;
+
+    for (count = 0; count < ts->nshards; count++) {
+        status = timer_shard_destroy(&ts->shards[count]);
+        if (status != 0)
+            return status;
+    }
+
+    free(ts->shards);
+    free(ts->workers);
+
+    status = pthread_mutex_destroy(&ts->work_mutex);
+    status1 = pthread_cond_destroy(&ts->work_cv);
+    return (status ? status : status1);
+}
+
+static timer_shard_t *timer_local_shard(timer_service_t *ts)
+{
+    static __thread int home = -1;
+    static int next_home = 0;
+    int cpu;
+
+    cpu = sched_getcpu();
+    if (cpu >= 0)
+        return &ts->shards[cpu % ts->nshards];
+
+    if (home < 0)
+        home = __sync_fetch_and_add(&next_home, 1);
+    return &ts->shards[home % ts->nshards];
+}
+
+int timer_schedule(timer_service_t *ts, uint64_t deadline,
+    void (*callback)(void *), void *arg, timer_id_t *id)
+{
+    return timer_schedule_slack(ts, deadline, 0, callback, arg, id);
+}
+
+int timer_schedule_slack(timer_service_t *ts, uint64_t deadline, uint64_t slack,
+    void (*callback)(void *), void *arg, timer_id_t *id)
+{
+    timer_shard_t *shard;
+    timer_event_t *event;
+    int status;
+
+    if (ts->valid != TIMER_VALID || callback == NULL)
+        return EINVAL;
+
+    event = (timer_event_t *)malloc(sizeof(timer_event_t));
+    if (event == NULL)
+        return ENOMEM;
+
+    event->deadline = deadline;
+    event->latest = slack > UINT64_MAX - deadline ? UINT64_MAX : deadline + slack;
+    event->callback = callback;
+    event->arg = arg;
+
+    shard = timer_local_shard(ts);
+    status = pthread_mutex_lock(&shard->mutex);
+    if (status != 0) {
+        free(event);
+        return status;
+    }
+
+    status = timer_heap_insert(shard, event);
+    if (status != 0) {
+        pthread_mutex_unlock(&shard->mutex);
+        free(event);
+        return status;
+    }
+
+    event->id = shard->next_id++ * ts->nshards + shard->index;
+    timer_hash_insert(shard, event);
+    shard->stats.inserted++;
+
+    if (event->index == 0) {
+        status = pthread_cond_signal(&shard->cv);
+        if (status != 0) {
+            pthread_mutex_unlock(&shard->mutex);
+            return status;
+        }
+    }
+
+    if (id != NULL)
+        *id = event->id;
+
+    return pthread_mutex_unlock(&shard->mutex);
+}
+
+/*
+ * A timer can be cancelled until a worker takes it off the work list;
+ * after that the callback is running or done and ENOENT is returned.
+ */
+int timer_cancel(timer_service_t *ts, timer_id_t id, void **arg)
+{
+    timer_shard_t *shard;
+    timer_event_t *event;
+    int status;
+
+    if (ts->valid != TIMER_VALID)
+        return EINVAL;
+
+    shard = &ts->shards[id % ts->nshards];
+    status = pthread_mutex_lock(&shard->mutex);
+    if (status != 0)
+        return status;
+
+    event = *timer_hash_slot(shard, id);
+    if (event == NULL) {
+        pthread_mutex_unlock(&shard->mutex);
+        return ENOENT;
+    }
+
+    if (__atomic_load_n(&event->index, __ATOMIC_RELAXED) >= 0)
+        timer_heap_remove(shard, event->index);
+    else {
+        status = pthread_mutex_lock(&ts->work_mutex);
+        if (status != 0) {
+            pthread_mutex_unlock(&shard->mutex);
+            return status;
+        }
+
+        if (event->index == TIMER_RUNNING) {
+            pthread_mutex_unlock(&ts->work_mutex);
+            pthread_mutex_unlock(&shard->mutex);
+            return ENOENT;
+        }
+
+        if (event->prev != NULL)
+            event->prev->link = event->link;
+        else
+            ts->first = event->link;
+        if (event->link != NULL)
+            event->link->prev = event->prev;
+        else
+            ts->last = event->prev;
+        pthread_mutex_unlock(&ts->work_mutex);
+    }
+
+    timer_hash_remove(shard, event);
+    pthread_mutex_unlock(&shard->mutex);
+    if (arg != NULL)
+        *arg = event->arg;
+    free(event);
+    return 0;
+}
+
+int timer_shard_stats(timer_service_t *ts, int shard, timer_stats_t *stats)
+{
+    int status;
+
+    if (ts->valid != TIMER_VALID || shard < 0 || shard >= ts->nshards)
+        return EINVAL;
+
+    status = pthread_mutex_lock(&ts->shards[shard].mutex);
+    if (status != 0)
+        return status;
+
+    *stats = ts->shards[shard].stats;
+    return pthread_mutex_unlock(&ts->shards[shard].mutex);
+}
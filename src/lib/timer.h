@@ -0,0 +1,90 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "forksafe.h"
+
+#define TIMER_CACHE_LINE 64
+
+typedef unsigned long timer_id_t;
+
+/*
+ * index is the event's heap slot, or TIMER_QUEUED once it has expired
+ * onto the work list, or TIMER_RUNNING once a worker has taken it.
+ */
+typedef struct timer_event_tag {
+    struct timer_event_tag  *link, *prev;
+    struct timer_event_tag  *hash_link;
+    uint64_t                deadline;
+    uint64_t                latest;
+    timer_id_t              id;
+    int                     index;
+    void                    (*callback)(void *);
+    void                    *arg;
+} timer_event_t;
+
+typedef struct timer_stats_tag {
+    int                 depth;
+    unsigned long       inserted;
+    unsigned long       fired;
+    unsigned long       wakeups;
+    uint64_t            lag_total;
+    uint64_t            lag_max;
+} timer_stats_t;
+
+typedef struct timer_shard_tag {
+    pthread_mutex_t             mutex;
+    pthread_cond_t              cv;
+    pthread_t                   alarm_thread;
+    struct timer_service_tag    *service;
+    timer_event_t               **heap;
+    int                         capacity;
+    timer_event_t               **buckets;
+    int                         nbuckets;
+    int                         hashed;
+    int                         index;
+    int                         quit;
+    timer_id_t                  next_id;
+    timer_stats_t               stats;
+} __attribute__((aligned(TIMER_CACHE_LINE))) timer_shard_t;
+
+typedef struct timer_service_tag {
+    pthread_mutex_t     work_mutex;
+    pthread_cond_t      work_cv;
+    pthread_t           *workers;
+    timer_shard_t       *shards;
+    timer_event_t       *first, *last;
+    forksafe_t          fork;
+    int                 valid;
+    int                 quit;
+    int                 nshards;
+    int                 parallelism;
+    int                 profile;
+} timer_service_t;
+
+#define TIMER_VALID 0x7173e5
+
+#define TIMER_QUEUED    -1
+#define TIMER_RUNNING   -2
+
+#define TIMER_NSEC_PER_SEC  1000000000ULL
+#define TIMER_NSEC_PER_MSEC 1000000ULL
+
+uint64_t timer_now(void);
+int timer_service_init(timer_service_t *ts, int shards, int workers);
+int timer_service_init_profile(timer_service_t *ts, int shards, int workers,
+    int alarm_profile);
+int timer_service_destroy(timer_service_t *ts);
+int timer_schedule(timer_service_t *ts, uint64_t deadline,
+    void (*callback)(void *), void *arg, timer_id_t *id);
+int timer_schedule_slack(timer_service_t *ts, uint64_t deadline, uint64_t slack,
+    void (*callback)(void *), void *arg, timer_id_t *id);
+/*
+ * A cancelled timer's callback never runs; its arg is passed back
+ * through arg (if not NULL) so the caller can release it.
+ */
+int timer_cancel(timer_service_t *ts, timer_id_t id, void **arg);
+int timer_shard_stats(timer_service_t *ts, int shard, timer_stats_t *stats);
+
+#endif //TIMER_H
@@ -0,0 +1,149 @@
+#include "errors.h"
+#include "tls.h"
+
+__thread tls_thread_t tls_self;
+
+static unsigned long tls_used = 0;
+static void (*tls_destructors[TLS_MAX_KEYS])(void *);
+
+static pthread_once_t tls_once = PTHREAD_ONCE_INIT;
+static pthread_key_t tls_exit_key;
+static pthread_mutex_t tls_mutex = PTHREAD_MUTEX_INITIALIZER;
+static tls_thread_t *tls_threads = NULL;
+
+static void tls_unregister(tls_thread_t *self)
+{
+    tls_thread_t **last;
+
+    pthread_mutex_lock(&tls_mutex);
+    for (last = &tls_threads; *last != NULL; last = &(*last)->next) {
+        if (*last == self) {
+            *last = self->next;
+            break;
+        }
+    }
+    self->registered = 0;
+    pthread_mutex_unlock(&tls_mutex);
+}
+
+static void tls_thread_exit(void *arg)
+{
+    tls_thread_t *self = (tls_thread_t *)arg;
+    void (*destructor)(void *);
+    void *value;
+    int key;
+
+    tls_unregister(self);
+
+    for (key = 0; key < TLS_MAX_KEYS; key++) {
+        value = self->values[key];
+        if (value == NULL)
+            continue;
+
+        self->values[key] = NULL;
+        destructor = __atomic_load_n(&tls_destructors[key], __ATOMIC_ACQUIRE);
+        if (destructor != NULL)
+            destructor(value);
+    }
+}
+
+static void tls_init_routine(void)
+{
+    int status;
+
+    status = pthread_key_create(&tls_exit_key, tls_thread_exit);
+    if (status != 0)
+        err_abort(status, "Create exit key");
+}
+
+int tls_register(void)
+{
+    int status;
+
+    status = pthread_once(&tls_once, tls_init_routine);
+    if (status != 0)
+        return status;
+
+    status = pthread_setspecific(tls_exit_key, &tls_self);
+    if (status != 0)
+        return status;
+
+    status = pthread_mutex_lock(&tls_mutex);
+    if (status != 0)
+        return status;
+
+    tls_self.thread_id = pthread_self();
+    tls_self.next = tls_threads;
+    tls_threads = &tls_self;
+    tls_self.registered = 1;
+
+    return pthread_mutex_unlock(&tls_mutex);
+}
+
+int tls_key_create(tls_key_t *key, void (*destructor)(void *))
+{
+    unsigned long used, bit;
+    int slot;
+
+    used = __atomic_load_n(&tls_used, __ATOMIC_RELAXED);
+    do {
+        if (~used == 0)
+            return EAGAIN;
+        slot = __builtin_ctzl(~used);
+        bit = 1UL << slot;
+    } while (!__atomic_compare_exchange_n(&tls_used, &used, used | bit, 1,
+        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    __atomic_store_n(&tls_destructors[slot], destructor, __ATOMIC_RELEASE);
+    *key = slot;
+    return 0;
+}
+
+int tls_key_delete(tls_key_t key)
+{
+    tls_thread_t *thread;
+    int status;
+
+    if (key < 0 || key >= TLS_MAX_KEYS)
+        return EINVAL;
+
+    status = pthread_mutex_lock(&tls_mutex);
+    if (status != 0)
+        return status;
+
+    for (thread = tls_threads; thread != NULL; thread = thread->next)
+        __atomic_store_n(&thread->values[key], NULL, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&tls_destructors[key], NULL, __ATOMIC_RELEASE);
+    __atomic_fetch_and(&tls_used, ~(1UL << key), __ATOMIC_RELEASE);
+    return pthread_mutex_unlock(&tls_mutex);
+}
+
+/*
+ * Runs routine on each registered thread's non-NULL value for key. The
+ * registry mutex keeps thread records alive, but not the values: an
+ * owner may replace and free its value through tls_set() while routine
+ * reads it. Callers must quiesce the owners first, or have them defer
+ * freeing old values until tls_foreach() has returned.
+ */
+int tls_foreach(tls_key_t key, void (*routine)(pthread_t, void *, void *), void *arg)
+{
+    tls_thread_t *thread;
+    void *value;
+    int status;
+
+    if (key < 0 || key >= TLS_MAX_KEYS)
+        return EINVAL;
+
+    status = pthread_mutex_lock(&tls_mutex);
+    if (status != 0)
+        return status;
+
+    for (thread = tls_threads; thread != NULL; thread = thread->next) {
+        value = __atomic_load_n(&thread->values[key], __ATOMIC_ACQUIRE);
+        if (value != NULL)
+            routine(thread->thread_id, value, arg);
+    }
+
+    return pthread_mutex_unlock(&tls_mutex);
+}
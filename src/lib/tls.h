@@ -0,0 +1,43 @@
+#ifndef TLS_H
+#define TLS_H
+
+#include <pthread.h>
+
+#define TLS_MAX_KEYS 64
+
+typedef int tls_key_t;
+
+typedef struct tls_thread_tag {
+    struct tls_thread_tag   *next;
+    pthread_t               thread_id;
+    int                     registered;
+    void                    *values[TLS_MAX_KEYS];
+} tls_thread_t;
+
+extern __thread tls_thread_t tls_self;
+
+int tls_key_create(tls_key_t *key, void (*destructor)(void *));
+int tls_key_delete(tls_key_t key);
+int tls_register(void);
+int tls_foreach(tls_key_t key, void (*routine)(pthread_t, void *, void *), void *arg);
+
+static inline void *tls_get(tls_key_t key)
+{
+    return tls_self.values[key];
+}
+
+static inline int tls_set(tls_key_t key, void *value)
+{
+    int status;
+
+    if (!tls_self.registered) {
+        status = tls_register();
+        if (status != 0)
+            return status;
+    }
+
+    __atomic_store_n(&tls_self.values[key], value, __ATOMIC_RELEASE);
+    return 0;
+}
+
+#endif //TLS_H
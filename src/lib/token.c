@@ -0,0 +1,277 @@
+#include <time.h>
+#include "errors.h"
+#include "token.h"
+
+static pthread_mutex_t token_waker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t token_waker_cv = PTHREAD_COND_INITIALIZER;
+static pthread_once_t token_waker_once = PTHREAD_ONCE_INIT;
+static token_waiter_t *token_waker_queue = NULL;
+static int token_waker_status = 0;
+
+int token_init(token_t *token, token_t *parent)
+{
+    int status;
+
+    status = pthread_mutex_init(&token->mutex, NULL);
+    if (status != 0)
+        return status;
+    status = pthread_cond_init(&token->deferred_cv, NULL);
+    if (status != 0) {
+        pthread_mutex_destroy(&token->mutex);
+        return status;
+    }
+
+    token->cancelled = 0;
+    token->parent = parent;
+    token->children = NULL;
+    token->sibling = NULL;
+    token->waiters = NULL;
+
+    if (parent != NULL) {
+        status = pthread_mutex_lock(&parent->mutex);
+        if (status != 0) {
+            pthread_cond_destroy(&token->deferred_cv);
+            pthread_mutex_destroy(&token->mutex);
+            return status;
+        }
+        token->sibling = parent->children;
+        parent->children = token;
+        token->cancelled = parent->cancelled;
+        pthread_mutex_unlock(&parent->mutex);
+    }
+
+    token->valid = TOKEN_VALID;
+    return 0;
+}
+
+int token_destroy(token_t *token)
+{
+    token_t **last;
+    int status;
+
+    if (token->valid != TOKEN_VALID)
+        return EINVAL;
+
+    status = pthread_mutex_lock(&token->mutex);
+    if (status != 0)
+        return status;
+
+    if (token->children != NULL || token->waiters != NULL) {
+        pthread_mutex_unlock(&token->mutex);
+        return EBUSY;
+    }
+    token->valid = 0;
+    pthread_mutex_unlock(&token->mutex);
+
+    if (token->parent != NULL) {
+        status = pthread_mutex_lock(&token->parent->mutex);
+        if (status != 0)
+            return status;
+        for (last = &token->parent->children; *last != NULL; last = &(*last)->sibling) {
+            if (*last == token) {
+                *last = token->sibling;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&token->parent->mutex);
+    }
+
+    pthread_cond_destroy(&token->deferred_cv);
+    return pthread_mutex_destroy(&token->mutex);
+}
+
+/*
+ * Broadcasts on behalf of cancellers that could not take a waiter's
+ * mutex. Blocking on that mutex here is safe: the waker holds no other
+ * lock meanwhile, and the waiter does not return until the waker has
+ * finished with it.
+ */
+static void *token_waker(void *arg)
+{
+    token_waiter_t *waiter;
+    token_t *token;
+
+    pthread_mutex_lock(&token_waker_mutex);
+    while (1) {
+        while (token_waker_queue == NULL)
+            pthread_cond_wait(&token_waker_cv, &token_waker_mutex);
+        waiter = token_waker_queue;
+        token_waker_queue = waiter->deferred_next;
+        pthread_mutex_unlock(&token_waker_mutex);
+
+        token = waiter->token;
+        pthread_mutex_lock(waiter->mutex);
+        pthread_cond_broadcast(waiter->cv);
+        pthread_mutex_unlock(waiter->mutex);
+
+        pthread_mutex_lock(&token->mutex);
+        waiter->deferred = 0;
+        pthread_cond_broadcast(&token->deferred_cv);
+        pthread_mutex_unlock(&token->mutex);
+
+        pthread_mutex_lock(&token_waker_mutex);
+    }
+    return NULL;
+}
+
+static void token_waker_start(void)
+{
+    pthread_attr_t attr;
+    pthread_t id;
+
+    token_waker_status = pthread_attr_init(&attr);
+    if (token_waker_status != 0)
+        return;
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    token_waker_status = pthread_create(&id, &attr, token_waker, NULL);
+    pthread_attr_destroy(&attr);
+}
+
+/*
+ * A waiter holds its own mutex from the cancelled check until
+ * pthread_cond_wait() releases it, so a broadcast made without that
+ * mutex can be lost. The canceller only try-locks it, since it may hold
+ * the mutex itself. When that fails the broadcast is handed to the waker
+ * thread, which can afford to block on the mutex.
+ */
+static void token_wake_waiters(token_t *token)
+{
+    token_waiter_t *waiter;
+
+    pthread_mutex_lock(&token->mutex);
+    for (waiter = token->waiters; waiter != NULL; waiter = waiter->next) {
+        if (waiter->signaled)
+            continue;
+        waiter->signaled = 1;
+
+        if (pthread_mutex_trylock(waiter->mutex) == 0) {
+            pthread_cond_broadcast(waiter->cv);
+            pthread_mutex_unlock(waiter->mutex);
+            continue;
+        }
+
+        /* Without a waker, a broadcast still reaches a waiter already asleep. */
+        pthread_once(&token_waker_once, token_waker_start);
+        if (token_waker_status != 0) {
+            pthread_cond_broadcast(waiter->cv);
+            continue;
+        }
+
+        waiter->token = token;
+        waiter->deferred = 1;
+        pthread_mutex_lock(&token_waker_mutex);
+        waiter->deferred_next = token_waker_queue;
+        token_waker_queue = waiter;
+        pthread_cond_signal(&token_waker_cv);
+        pthread_mutex_unlock(&token_waker_mutex);
+    }
+    pthread_mutex_unlock(&token->mutex);
+}
+
+int token_cancel(token_t *token)
+{
+    token_t *child;
+    int status;
+
+    if (token->valid != TOKEN_VALID)
+        return EINVAL;
+
+    __atomic_store_n(&token->cancelled, 1, __ATOMIC_RELEASE);
+    token_wake_waiters(token);
+
+    status = pthread_mutex_lock(&token->mutex);
+    if (status != 0)
+        return status;
+    for (child = token->children; child != NULL; child = child->sibling)
+        token_cancel(child);
+    return pthread_mutex_unlock(&token->mutex);
+}
+
+int token_cond_timedwait(token_t *token, pthread_cond_t *cv, pthread_mutex_t *mutex,
+    const struct timespec *abstime)
+{
+    token_waiter_t waiter, **last;
+    int status;
+
+    waiter.cv = cv;
+    waiter.mutex = mutex;
+    waiter.signaled = 0;
+    waiter.deferred = 0;
+
+    status = pthread_mutex_lock(&token->mutex);
+    if (status != 0)
+        return status;
+    waiter.next = token->waiters;
+    token->waiters = &waiter;
+    pthread_mutex_unlock(&token->mutex);
+
+    if (__atomic_load_n(&token->cancelled, __ATOMIC_ACQUIRE))
+        status = ECANCELED;
+    else if (abstime == NULL)
+        status = pthread_cond_wait(cv, mutex);
+    else
+        status = pthread_cond_timedwait(cv, mutex, abstime);
+
+    pthread_mutex_lock(&token->mutex);
+    for (last = &token->waiters; *last != NULL; last = &(*last)->next) {
+        if (*last == &waiter) {
+            *last = waiter.next;
+            break;
+        }
+    }
+
+    /* The waker still needs our mutex to finish a deferred broadcast. */
+    if (waiter.deferred) {
+        pthread_mutex_unlock(mutex);
+        while (waiter.deferred)
+            pthread_cond_wait(&token->deferred_cv, &token->mutex);
+        pthread_mutex_unlock(&token->mutex);
+        pthread_mutex_lock(mutex);
+    } else
+        pthread_mutex_unlock(&token->mutex);
+
+    if (status == 0 && __atomic_load_n(&token->cancelled, __ATOMIC_ACQUIRE))
+        status = ECANCELED;
+    return status;
+}
+
+int token_cond_wait(token_t *token, pthread_cond_t *cv, pthread_mutex_t *mutex)
+{
+    return token_cond_timedwait(token, cv, mutex, NULL);
+}
+
+int token_sleep(token_t *token, uint64_t nsec)
+{
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_condattr_t attr;
+    pthread_cond_t cv;
+    struct timespec abstime;
+    int status;
+
+    status = pthread_condattr_init(&attr);
+    if (status != 0)
+        return status;
+    status = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if (status == 0)
+        status = pthread_cond_init(&cv, &attr);
+    pthread_condattr_destroy(&attr);
+    if (status != 0)
+        return status;
+
+    clock_gettime(CLOCK_MONOTONIC, &abstime);
+    abstime.tv_sec += nsec / 1000000000ULL;
+    abstime.tv_nsec += nsec % 1000000000ULL;
+    if (abstime.tv_nsec >= 1000000000L) {
+        abstime.tv_sec++;
+        abstime.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&mutex);
+    while (status == 0)
+        status = token_cond_timedwait(token, &cv, &mutex, &abstime);
+    pthread_mutex_unlock(&mutex);
+
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&cv);
+    return status == ETIMEDOUT ? 0 : status;
+}
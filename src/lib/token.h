@@ -0,0 +1,49 @@
+#ifndef TOKEN_H
+#define TOKEN_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+typedef struct token_waiter_tag {
+    struct token_waiter_tag *next;
+    struct token_waiter_tag *deferred_next;
+    struct token_tag        *token;
+    pthread_cond_t          *cv;
+    pthread_mutex_t         *mutex;
+    int                     signaled;
+    int                     deferred;
+} token_waiter_t;
+
+/*
+ * A cancellation token. Cancelling a token also cancels every token
+ * created with it as parent. Workers poll token_cancelled(), which is a
+ * relaxed load, and block in token_cond_wait() or token_sleep(), which
+ * return ECANCELED as soon as the token is cancelled.
+ */
+typedef struct token_tag {
+    int                 cancelled;
+    pthread_mutex_t     mutex;
+    struct token_tag    *parent;
+    struct token_tag    *children;
+    struct token_tag    *sibling;
+    token_waiter_t      *waiters;
+    pthread_cond_t      deferred_cv;
+    int                 valid;
+} token_t;
+
+#define TOKEN_VALID 0xca9ce1
+
+int token_init(token_t *token, token_t *parent);
+int token_destroy(token_t *token);
+int token_cancel(token_t *token);
+int token_cond_wait(token_t *token, pthread_cond_t *cv, pthread_mutex_t *mutex);
+int token_cond_timedwait(token_t *token, pthread_cond_t *cv, pthread_mutex_t *mutex,
+    const struct timespec *abstime);
+int token_sleep(token_t *token, uint64_t nsec);
+
+static inline int token_cancelled(token_t *token)
+{
+    return __atomic_load_n(&token->cancelled, __ATOMIC_RELAXED);
+}
+
+#endif //TOKEN_H